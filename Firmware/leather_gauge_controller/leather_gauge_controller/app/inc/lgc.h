@@ -35,6 +35,16 @@ extern error_t lgc_modbus_read_coils(uint8_t dev, uint16_t address, uint8_t *coi
 
 extern error_t lgc_modbus_write_holding_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len);
 
+extern error_t lgc_modbus_snapshot(uint16_t seq, uint16_t *values, size_t count, uint16_t *missing);
+
+extern error_t lgc_modbus_latch(uint16_t seq);
+
+extern error_t lgc_modbus_sync(uint16_t id);
+
+extern error_t lgc_modbus_read_sync(uint8_t dev, uint16_t id, uint16_t *value);
+
+extern error_t lgc_modbus_baud_negotiate(uint8_t code, uint8_t count, uint16_t *missing);
+
 extern void lgc_buttons_callback(uint8_t di, uint32_t evt);
 
 extern void lgc_set_stop_condition(uint8_t stop);
@@ -19,6 +19,11 @@
 #define LGC_SENSOR_NUMBER 11
 #endif
 
+/* Number of photoreceptors per sensor */
+#ifndef LGC_PHOTORECEPTORS_PER_SENSOR
+#define LGC_PHOTORECEPTORS_PER_SENSOR 10
+#endif
+
 #ifndef LGC_LEATHER_COUNT_MAX
 #define LGC_LEATHER_COUNT_MAX 300
 #endif
@@ -39,6 +44,16 @@ typedef enum
     LGC_INPUT_MAX,
 } LGC_INPUTS_TypeDef_t;
 
+typedef struct
+{
+    uint8_t failures;    /* Consecutive failed reads */
+    uint8_t quarantined; /* Only probed every backoff steps */
+    uint16_t backoff;    /* Steps between probes while quarantined */
+    uint16_t probe_in;   /* Steps left until the next probe */
+    uint16_t stale;      /* Steps since the last good value */
+    uint16_t last_good;  /* Last value read from the sensor */
+} lgc_sensor_health_t;
+
 typedef struct
 {
     /*state machine*/
@@ -47,6 +62,10 @@ typedef struct
     uint16_t sensor_status;
     /*sensor data*/
     uint16_t sensor[LGC_SENSOR_NUMBER];
+    /*sensors estimated in the current slice*/
+    uint16_t sensor_estimated;
+    /*per sensor health*/
+    lgc_sensor_health_t health[LGC_SENSOR_NUMBER];
     /*set start/stop flag*/
     uint8_t start_stop_flag;
     /*guard motor*/
@@ -66,6 +85,9 @@ typedef struct
     float current_leather_area;                           /* Accumulator for current leather area */
     float leather_measurement[LGC_LEATHER_COUNT_MAX];     /* Individual leather areas */
     float leather_measurement_last[LGC_LEATHER_COUNT_MAX];     /* Individual leather areas */
+    uint16_t current_leather_estimated;                   /* Sensors estimated while measuring this leather */
+    uint16_t leather_estimated[LGC_LEATHER_COUNT_MAX];    /* Estimated sensors per leather (0: all read) */
+    uint16_t leather_estimated_last[LGC_LEATHER_COUNT_MAX]; /* Estimated sensors per leather, last batch */
     float batch_measurement[LGC_LEATHER_BATCH_COUNT_MAX]; /* Batch sums */
     uint8_t is_measuring;                                 /* Measuring state flag */
     uint8_t no_detection_count;                           /* Consecutive steps with no detection */
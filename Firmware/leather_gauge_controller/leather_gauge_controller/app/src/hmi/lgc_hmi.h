@@ -98,10 +98,25 @@ typedef enum
 	LGC_HMI_VP_PRINT = 0x1400, // Botón que indica que se cierra el lote tal como está
 
 	LGC_HMI_VP_LIST_DELETE = 0x1501,			  // Botón que elimina el último cuero medido
-	LGC_HMI_VP_LIST_ADDRESS_LEATHER_BASE = 0x1601 // Dirección base del primer cuero guardado.
+	LGC_HMI_VP_LIST_ADDRESS_LEATHER_BASE = 0x1601, // Dirección base del primer cuero guardado.
+
+	// Diagnóstico del bus de sensores (página 21), tiempos en us
+	LGC_HMI_VP_DIAG_SCAN_MIN = 0x1800,	  // Tiempo mínimo de barrido
+	LGC_HMI_VP_DIAG_SCAN_AVG = 0x1801,	  // Tiempo promedio de barrido
+	LGC_HMI_VP_DIAG_SCAN_MAX = 0x1802,	  // Tiempo máximo de barrido
+	LGC_HMI_VP_DIAG_SCAN_LOAD = 0x1803,	  // Porcentaje del periodo del encoder usado por el barrido
+	LGC_HMI_VP_DIAG_NOISE = 0x1804,		  // Tramas recibidas que no son de ningún sensor
+	LGC_HMI_VP_DIAG_RESET = 0x1805,		  // Botón que borra las estadísticas (antes las vuelca al log, si está activo)
+	LGC_HMI_VP_DIAG_SENSOR_BASE = 0x1810, // Dirección base del sensor 1, LGC_HMI_DIAG_SENSOR_STRIDE por sensor:
+										  // +0 respuesta promedio, +1 respuesta máxima, +2 timeouts, +3 errores CRC, +4 excepciones
+	LGC_HMI_VP_DIAG_HIST_BASE = 0x1900,	  // Histograma de respuestas del sensor 1, LGC_HMI_DIAG_HIST_STRIDE por sensor:
+										  // +n respuestas en el intervalo n (ver LGC_MODBUS_STATS_BIN0_US)
 
 } LGC_HMI_VAR_ADDR_TypeDef_t;
 
+#define LGC_HMI_DIAG_SENSOR_STRIDE 8
+#define LGC_HMI_DIAG_HIST_STRIDE 8
+
 typedef enum
 {
 	LGC_HMI_TOUCH_PAGE_ADDR = 0x1005, // Dirección de la página actual
@@ -13,6 +13,7 @@
 #include "usart.h"
 #include "lgc_hmi.h"
 #include "lgc_module_rtc.h"
+#include "lgc_interface_modbus.h"
 
 //-------------------------------------------------------------------------------
 // defines
@@ -107,6 +108,7 @@ void lgc_dwin_uart_TxCpltCallback(UART_HandleTypeDef *huart);
 static void on_dwin_event(dwin_evt_t *evt, void *ctx);
 error_t lgc_hmi_send_msg(dwin_evt_t *evt);
 static void hmi_set_current_page(uint8_t page);
+static uint16_t hmi_u16_sat(uint32_t value);
 //-------------------------------------------------------------------------------
 // task definition
 //-------------------------------------------------------------------------------
@@ -119,6 +121,10 @@ void lgc_hmi_update_task_entry(void *param)
 	LGC_CONF_TypeDef_t conf = {0};
 	uint16_t value = 0;
 	uint16_t vp_addr = 0;
+	lgc_modbus_sensor_stats_t sensor_stats;
+	lgc_modbus_segment_stats_t segment_stats;
+	lgc_modbus_segment_stats_t slowest;
+	uint32_t noise;
 	/*alloc memory for measurements*/
 	measurements = osAllocMem(sizeof(lgc_measurements_t));
 	if (measurements == NULL)
@@ -225,6 +231,49 @@ void lgc_hmi_update_task_entry(void *param)
 
 			break;
 		}
+		case HMI_PAGE21:
+		{
+			// sensor bus diagnostics, refreshed every second
+			// segments run in parallel: the slowest one sets the scan time
+			memset(&slowest, 0, sizeof(slowest));
+			noise = 0;
+			for (uint8_t n = 0; lgc_modbus_stats_segment(n, &segment_stats) == NO_ERROR; n++)
+			{
+				noise += segment_stats.noise;
+				if (n == 0 || lgc_modbus_stats_avg(&segment_stats.scan) > lgc_modbus_stats_avg(&slowest.scan))
+				{
+					slowest = segment_stats;
+				}
+			}
+			dwin_write_vp_u16(&dwin_hmi, LGC_HMI_VP_DIAG_SCAN_MIN, hmi_u16_sat(slowest.scan.min));
+			dwin_write_vp_u16(&dwin_hmi, LGC_HMI_VP_DIAG_SCAN_AVG, hmi_u16_sat(lgc_modbus_stats_avg(&slowest.scan)));
+			dwin_write_vp_u16(&dwin_hmi, LGC_HMI_VP_DIAG_SCAN_MAX, hmi_u16_sat(slowest.scan.max));
+			value = 0;
+			if (lgc_modbus_stats_avg(&slowest.period) != 0)
+			{
+				value = hmi_u16_sat(lgc_modbus_stats_avg(&slowest.scan) * 100UL / lgc_modbus_stats_avg(&slowest.period));
+			}
+			dwin_write_vp_u16(&dwin_hmi, LGC_HMI_VP_DIAG_SCAN_LOAD, value);
+			dwin_write_vp_u16(&dwin_hmi, LGC_HMI_VP_DIAG_NOISE, hmi_u16_sat(noise));
+			// per sensor
+			for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+			{
+				lgc_modbus_stats_sensor(i + 1, &sensor_stats);
+				vp_addr = LGC_HMI_VP_DIAG_SENSOR_BASE + i * LGC_HMI_DIAG_SENSOR_STRIDE;
+				dwin_write_vp_u16(&dwin_hmi, vp_addr, hmi_u16_sat(lgc_modbus_stats_avg(&sensor_stats.rtt)));
+				dwin_write_vp_u16(&dwin_hmi, vp_addr + 1, hmi_u16_sat(sensor_stats.rtt.max));
+				dwin_write_vp_u16(&dwin_hmi, vp_addr + 2, hmi_u16_sat(sensor_stats.timeouts));
+				dwin_write_vp_u16(&dwin_hmi, vp_addr + 3, hmi_u16_sat(sensor_stats.crc_errors));
+				dwin_write_vp_u16(&dwin_hmi, vp_addr + 4, hmi_u16_sat(sensor_stats.exceptions));
+				// reply time histogram
+				vp_addr = LGC_HMI_VP_DIAG_HIST_BASE + i * LGC_HMI_DIAG_HIST_STRIDE;
+				for (uint8_t bin = 0; bin < LGC_MODBUS_STATS_BINS && bin < LGC_HMI_DIAG_HIST_STRIDE; bin++)
+				{
+					dwin_write_vp_u16(&dwin_hmi, vp_addr + bin, hmi_u16_sat(sensor_stats.hist[bin]));
+				}
+			}
+			break;
+		}
 
 		default:
 			break;
@@ -362,8 +411,8 @@ void lgc_hmi_task_entry(void *param)
 		{
 			if (hmi_data.sensor_test_active)
 			{
-				/*get value: only test sensor comunication*/
-				if (lgc_modbus_read_holding_regs(hmi_data.sensor_test_id % 12, 12, &value, 1) != NO_ERROR)
+				/*store the threshold tuned with the slider in the sensor flash*/
+				if (lgc_modbus_conf_commit(hmi_data.sensor_test_id % 12) != NO_ERROR)
 				{
 					value = 2;
 				}
@@ -371,7 +420,6 @@ void lgc_hmi_task_entry(void *param)
 				{
 					value = 1;
 				}
-				/*store value*/
 			}
 			else if (hmi_data.current_page == HMI_PAGE7)
 			{
@@ -446,13 +494,22 @@ void lgc_hmi_task_entry(void *param)
 			conf.units = (uint8_t)value;
 			break;
 		}
+		// bus diagnostics: dump to the log (if enabled), then start over
+		case LGC_HMI_VP_DIAG_RESET:
+		{
+			lgc_modbus_stats_dump(LGC_SENSOR_NUMBER);
+			lgc_modbus_stats_reset();
+			// set hmi update
+			osSetEventBits(&events, LGC_HMI_UPDATE_REQUIRED);
+			break;
+		}
 		case LGC_HMI_VP_TEST_SLIDER_THRESHOLD_SENSOR:
 		{
 
 			// update 0x1109
 			value = (msg.data[0] << 8) | msg.data[1];
 			dwin_write_vp_u16(&dwin_hmi, 0x1109, value);
-			// set to sensor offset
+			// set to sensor threshold (staged in sensor ram, stored on save)
 			value = value * 40.96; // scale factor for slider
 			lgc_modbus_write_holding_regs(hmi_data.sensor_test_id % 12, 12, &value, 1);
 			// set update event
@@ -771,3 +828,9 @@ static void hmi_set_current_page(uint8_t page)
 	osReleaseMutex(&hmi_data.mutex);
 	return;
 }
+
+// clamp a counter or a time to a 16 bit DWIN variable
+static uint16_t hmi_u16_sat(uint32_t value)
+{
+	return (value > 0xFFFF) ? 0xFFFF : (uint16_t)value;
+}
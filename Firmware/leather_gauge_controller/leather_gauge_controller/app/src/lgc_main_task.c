@@ -13,12 +13,55 @@
 #include "lwbtn.h"
 #include "lgc_module_encoder.h"
 #include "lgc_module_rtc.h"
+#include "lgc_interface_modbus.h"
+#include "lgc_module_slice.h"
 //-------------------------------------------------------------------------------
 // defines
 //-------------------------------------------------------------------------------
 
-#ifndef LGC_SENSOR_READ_RETRY
-#define LGC_SENSOR_READ_RETRY 4
+/* Consecutive failed reads before a sensor is quarantined */
+#ifndef LGC_SENSOR_QUARANTINE_FAILS
+#define LGC_SENSOR_QUARANTINE_FAILS 3
+#endif
+
+/* Probe interval of a quarantined sensor in encoder steps, doubled on every failed probe */
+#ifndef LGC_SENSOR_PROBE_MIN_STEPS
+#define LGC_SENSOR_PROBE_MIN_STEPS 4
+#endif
+
+#ifndef LGC_SENSOR_PROBE_MAX_STEPS
+#define LGC_SENSOR_PROBE_MAX_STEPS 256
+#endif
+
+/* Steps the last good value may stand in for a failed sensor, neighbours after that */
+#ifndef LGC_SENSOR_HOLD_STEPS
+#define LGC_SENSOR_HOLD_STEPS 4
+#endif
+
+/* Acquisition modes:
+ * snapshot: latch + chained replies on every encoder step
+ * history : latch on every encoder step, slices collected in bursts from the sensor rings
+ * sync    : standard FC06 broadcast sync, then one FC03 read per sensor
+ * changes : like history, but only the DI changes are read and the slices rebuilt here
+ * fast    : like snapshot, with a 1 byte token and 3 byte replies (fast scan) */
+#define LGC_SCAN_SNAPSHOT 0
+#define LGC_SCAN_HISTORY 1
+#define LGC_SCAN_SYNC 2
+#define LGC_SCAN_CHANGES 3
+#define LGC_SCAN_FAST 4
+
+#ifndef LGC_SCAN_MODE
+#define LGC_SCAN_MODE LGC_SCAN_SNAPSHOT
+#endif
+
+/* Encoder steps collected per history burst (max LGC_MODBUS_HIST_SLICES_MAX) */
+#ifndef LGC_HISTORY_BURST
+#define LGC_HISTORY_BURST 8
+#endif
+
+/* Change log entries asked per read, a sensor with more pending is read again */
+#ifndef LGC_CHANGES_POLL
+#define LGC_CHANGES_POLL 2
 #endif
 
 /* Pixel width in mm (single sensor pixel) */
@@ -31,9 +74,6 @@
 #define LGC_ENCODER_STEP_MM 5.0f
 #endif
 
-/* Number of photoreceptors per sensor */
-#define LGC_PHOTORECEPTORS_PER_SENSOR 10
-
 /* Hysteresis for leather detection (consecutive steps with no detection) */
 #ifndef LGC_LEATHER_END_HYSTERESIS
 #define LGC_LEATHER_END_HYSTERESIS 3
@@ -44,8 +84,17 @@
 //-------------------------------------------------------------------------------
 lgc_t data;
 static lgc_measurements_t measurements;
+/* Photoreceptors of the current step, packed */
+static lgc_slice_t slice;
 static OsSemaphore encoder_flag;
 static OsMutex mutex;
+static lgc_modbus_xfer_t scan_xfer;
+static uint16_t scan_values[LGC_SENSOR_NUMBER];
+static uint16_t scan_seq = 0;
+static uint8_t slice_ready = 0;
+static uint16_t history_seq = 0;
+static lgc_modbus_slice_t history_slices[LGC_SENSOR_NUMBER][LGC_HISTORY_BURST];
+static uint16_t history_count[LGC_SENSOR_NUMBER];
 
 //-------------------------------------------------------------------------------
 // private function prototype
@@ -71,6 +120,95 @@ static void lgc_set_leds(uint8_t led, uint8_t state);
  */
 static uint8_t lgc_process_measurement(LGC_CONF_TypeDef_t *config);
 
+/**
+ * @brief Run the measurement algorithm on the slice in data.sensor and raise its events
+ * @param config Pointer to configuration structure with batch limit
+ */
+static void lgc_process_slice(LGC_CONF_TypeDef_t *config);
+
+/**
+ * @brief Snapshot acquisition: latch and collect one slice per encoder step
+ * @param config Pointer to configuration structure
+ */
+static void lgc_scan_snapshot(LGC_CONF_TypeDef_t *config);
+
+/**
+ * @brief History acquisition: latch every step, collect the slices in bursts
+ * @param config Pointer to configuration structure
+ */
+static void lgc_scan_history(LGC_CONF_TypeDef_t *config);
+
+/**
+ * @brief Collect and process the steps latched since the last burst
+ *
+ * Called by lgc_scan_history on a full burst and before leaving RUNNING,
+ * so the partial burst of a stop or a failure is still measured.
+ *
+ * @param config Pointer to configuration structure
+ */
+static void lgc_scan_history_flush(LGC_CONF_TypeDef_t *config);
+
+/**
+ * @brief Sync acquisition: broadcast a sync id, read back the latched values
+ * @param config Pointer to configuration structure
+ */
+static void lgc_scan_sync(LGC_CONF_TypeDef_t *config);
+
+/**
+ * @brief Recover the slice of a sensor that missed the snapshot reply
+ * @param sensor Sensor index (address - 1)
+ * @param seq Sequence of the slice
+ * @return error_t NO_ERROR if data.sensor[sensor] was updated
+ */
+static error_t lgc_read_sensor_slice(uint8_t sensor, uint16_t seq);
+
+/**
+ * @brief Rebuild the burst slices of a sensor from its change log
+ *
+ * Fills history_slices/history_count like a history read, falling back to
+ * one when the change log overflowed.
+ *
+ * @param sensor Sensor index (address - 1)
+ * @param steps Encoder steps in the burst
+ * @return error_t Status of the reads
+ */
+static error_t lgc_read_sensor_changes(uint8_t sensor, uint16_t steps);
+
+/**
+ * @brief Tell whether a sensor should be addressed in this step
+ *
+ * Healthy and suspect sensors always are; a quarantined one only when its
+ * probe is due, so a dead node costs one timeout every backoff steps.
+ *
+ * @param sensor Sensor index (address - 1)
+ * @param steps Encoder steps since the last call (the burst size in history and changes mode)
+ * @return uint8_t TRUE if the sensor should be read
+ */
+static uint8_t lgc_sensor_should_read(uint8_t sensor, uint16_t steps);
+
+/**
+ * @brief Update the health of a sensor after a read attempt
+ * @param sensor Sensor index (address - 1)
+ * @param err Result of the attempt
+ */
+static void lgc_sensor_report(uint8_t sensor, error_t err);
+
+/**
+ * @brief Fill in the sensors flagged in data.sensor_status
+ *
+ * Uses the last good value while it is fresh, then the edge pixels of the
+ * healthy neighbours. Records the estimated sensors in data.sensor_estimated.
+ *
+ * @return uint8_t TRUE if at least one sensor was read and the slice can be processed
+ */
+static uint8_t lgc_sensor_estimate(void);
+
+/**
+ * @brief Bring the sensor bus to the configured baud rate
+ * @param config Pointer to configuration structure
+ */
+static void lgc_bus_setup(LGC_CONF_TypeDef_t *config);
+
 static uint16_t lgc_count_active_bits(void);
 
 static float lgc_calculate_slice_area(uint16_t active_bits);
@@ -80,10 +218,7 @@ static float lgc_calculate_slice_area(uint16_t active_bits);
 //-------------------------------------------------------------------------------
 void lgc_main_task_entry(void *param)
 {
-	error_t err = NO_ERROR;
-	uint8_t sensor_retry = 0;
 	LGC_CONF_TypeDef_t config;
-	uint8_t measurement_event; /* Event status from measurement processing */
 	RTC_Config_t rtc_config = {
 		.initial_datetime = {
 			.year = 2026,
@@ -100,6 +235,15 @@ void lgc_main_task_entry(void *param)
 	osCreateMutex(&mutex);
 
 	osCreateMutex(&measurements.mutex);
+	/*snapshot transaction, reused for every encoder step*/
+	lgc_modbus_xfer_init(&scan_xfer);
+#if (LGC_SCAN_MODE == LGC_SCAN_FAST)
+	scan_xfer.type = LGC_MODBUS_XFER_FAST;
+#else
+	scan_xfer.type = LGC_MODBUS_XFER_SNAPSHOT;
+#endif
+	scan_xfer.quantity = LGC_SENSOR_NUMBER;
+	scan_xfer.data = scan_values;
 	/*encoder init*/
 	lgc_module_encoder_init(lgc_encoder_callback);
 
@@ -108,6 +252,8 @@ void lgc_main_task_entry(void *param)
 	{
 		// handle error
 	}
+	// stored fields the test values below leave alone (baud)
+	lgc_module_conf_get(&config);
 	// test only
 	//--------------------------------
 	config.batch = 2;
@@ -119,6 +265,8 @@ void lgc_main_task_entry(void *param)
 	lgc_module_conf_set(&config);
 	//--------------------------------
 
+	lgc_bus_setup(&config);
+
 	for (;;)
 	{
 		lgc_module_conf_get(&config); // load configuration
@@ -142,6 +290,9 @@ void lgc_main_task_entry(void *param)
 					lgc_set_state(LGC_RUNNING);
 					// clear encoder flag
 					osWaitForSemaphore(&encoder_flag, 0);
+					// no slice pending from a previous run
+					slice_ready = 0;
+					history_seq = scan_seq;
 				}
 				else if (data.guard_motor)
 				{
@@ -161,6 +312,16 @@ void lgc_main_task_entry(void *param)
 			/* Verify stop condition and transition to LGC_STOP */
 			if (osWaitForEventBits(&events, LGC_EVENT_STOP | LGC_FAILURE_DETECTED, FALSE, TRUE, 0) == TRUE)
 			{
+				// the last slice collected is still pending (pipelined scan)
+				if (slice_ready)
+				{
+					lgc_process_slice(&config);
+					slice_ready = 0;
+				}
+#if (LGC_SCAN_MODE == LGC_SCAN_HISTORY || LGC_SCAN_MODE == LGC_SCAN_CHANGES)
+				// the steps of the partial burst are still in the sensor rings
+				lgc_scan_history_flush(&config);
+#endif
 				// set cero
 				osAcquireMutex(&mutex);
 				data.start_stop_flag = 0;
@@ -189,67 +350,13 @@ void lgc_main_task_entry(void *param)
 				// clear before data sensor
 				// memset(data.sensor, 0, sizeof(data.sensor));
 
-				/* Read all sensors with retry logic */
-				for (uint8_t i = 0; i < 11; i++)
-				{
-					sensor_retry = 0;
-					err = NO_ERROR;
-
-					/* Retry loop for Modbus read */
-					do
-					{
-						err = lgc_modbus_read_holding_regs(i + 1, 45, &data.sensor[i], 1);
-						if (err != NO_ERROR)
-						{
-							sensor_retry++;
-							osDelayTask(20);
-						}
-						else
-						{
-							break;
-						}
-					} while (sensor_retry <= LGC_SENSOR_READ_RETRY);
-
-					/* Update sensor status flags */
-					if (err != NO_ERROR)
-					{
-						data.sensor_status |= (1 << i);
-					}
-					else
-					{
-						data.sensor_status &= ~(1 << i);
-					}
-				}
-
-				/* Process measurement only if all sensors are healthy */
-				if (data.sensor_status == NO_ERROR)
-				{
-					// acquire measurements mutex
-					osAcquireMutex(&measurements.mutex);
-					/* Process measurement and get event status */
-					measurement_event = lgc_process_measurement(&config);
-					// release measurements mutex
-					osReleaseMutex(&measurements.mutex);
-					/* Handle measurement events
-					 * 0: No event (still measuring or idle)
-					 * 1: Leather measurement completed
-					 * 2: Batch measurement completed
-					 */
-					if (measurement_event == 1)
-					{
-						/* TODO: Signal leather completion (e.g., update UI, log event) */
-
-						// set hmi flag
-						osSetEventBits(&events, LGC_HMI_UPDATE_REQUIRED);
-					}
-					else if (measurement_event == 2)
-					{
-						/* TODO: Signal batch completion (e.g., save to EEPROM, print results) */
-
-						// set hmi flag and printer event
-						osSetEventBits(&events, LGC_HMI_UPDATE_REQUIRED | LGC_EVENT_PRINT_BATCH);
-					}
-				}
+#if (LGC_SCAN_MODE == LGC_SCAN_HISTORY || LGC_SCAN_MODE == LGC_SCAN_CHANGES)
+				lgc_scan_history(&config);
+#elif (LGC_SCAN_MODE == LGC_SCAN_SYNC)
+				lgc_scan_sync(&config);
+#else
+				lgc_scan_snapshot(&config);
+#endif
 			}
 
 			break;
@@ -366,30 +473,429 @@ static void lgc_set_leds(uint8_t led, uint8_t state)
 // private function definition
 //-------------------------------------------------------------------------------
 
-/**
- * @brief Count active bits (photoreceptors detecting leather) across all sensors
- * @return uint16_t Number of active photoreceptors (0-110)
- */
-static uint16_t lgc_count_active_bits(void)
+static void lgc_scan_snapshot(LGC_CONF_TypeDef_t *config)
+{
+	error_t err;
+	uint16_t seq = scan_seq++;
+	uint16_t missing = (1 << LGC_SENSOR_NUMBER) - 1;
+	uint8_t resync = FALSE;
+
+	/* Latch the new slice and process the previous one while the replies are on the wire */
+	scan_xfer.address = seq;
+	err = lgc_modbus_submit(&scan_xfer);
+
+	if (slice_ready)
+	{
+		lgc_process_slice(config);
+		slice_ready = 0;
+	}
+
+	if (err == NO_ERROR)
+	{
+		lgc_modbus_wait(&scan_xfer, INFINITE_DELAY);
+		missing = scan_xfer.missing;
+	}
+
+	for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+	{
+		if ((missing & (1 << i)) == 0)
+		{
+			/* A quarantined sensor that answers the broadcast is back */
+			data.sensor[i] = scan_values[i];
+			lgc_sensor_report(i, NO_ERROR);
+		}
+		else if (lgc_sensor_should_read(i, 1))
+		{
+			/* Fall back to the sensor history, then to a live read */
+			err = lgc_read_sensor_slice(i, seq);
+			lgc_sensor_report(i, err);
+			/* alive on modbus but silent on the token: rebooted, fast scan is off */
+			resync |= (err == NO_ERROR);
+		}
+		else
+		{
+			data.sensor_status |= (1 << i);
+		}
+	}
+
+#if (LGC_SCAN_MODE == LGC_SCAN_FAST)
+	if (resync)
+	{
+		lgc_modbus_fast_enable(TRUE);
+	}
+#else
+	(void)resync;
+#endif
+
+	/* Process measurement (next step), failed sensors estimated */
+	slice_ready = lgc_sensor_estimate();
+}
+
+static void lgc_scan_history(LGC_CONF_TypeDef_t *config)
+{
+	/* Latch only, the slice stays in the sensor rings */
+	lgc_modbus_latch(scan_seq++);
+
+	if ((uint16_t)(scan_seq - history_seq) < LGC_HISTORY_BURST)
+	{
+		return;
+	}
+
+	lgc_scan_history_flush(config);
+}
+
+static void lgc_scan_history_flush(LGC_CONF_TypeDef_t *config)
+{
+	error_t err;
+	uint16_t seq;
+	uint16_t steps;
+	uint16_t j;
+
+	steps = scan_seq - history_seq;
+	if (steps == 0)
+	{
+		return;
+	}
+
+	/* One burst per sensor, quarantined sensors only when probed */
+	for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+	{
+		history_count[i] = 0;
+
+		if (lgc_sensor_should_read(i, steps))
+		{
+#if (LGC_SCAN_MODE == LGC_SCAN_CHANGES)
+			err = lgc_read_sensor_changes(i, steps);
+#else
+			err = lgc_modbus_read_history(i + 1, history_seq - 1, history_slices[i], steps, &history_count[i]);
+#endif
+			if (err != NO_ERROR)
+			{
+				history_count[i] = 0;
+			}
+			lgc_sensor_report(i, err);
+		}
+	}
+
+	/* Rebuild the slices in encoder order */
+	for (uint16_t k = 0; k < steps; k++)
+	{
+		seq = history_seq + k;
+
+		for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+		{
+			/* slices are oldest first, a sensor may have missed some latches */
+			for (j = 0; j < history_count[i] && history_slices[i][j].seq != seq; j++)
+				;
+
+			if (j < history_count[i])
+			{
+				data.sensor[i] = history_slices[i][j].value;
+				data.sensor_status &= ~(1 << i);
+			}
+			else
+			{
+				data.sensor_status |= (1 << i);
+			}
+		}
+
+		if (lgc_sensor_estimate())
+		{
+			lgc_process_slice(config);
+		}
+	}
+
+	history_seq = scan_seq;
+}
+
+static void lgc_scan_sync(LGC_CONF_TypeDef_t *config)
+{
+	error_t err;
+	uint16_t seq = scan_seq++;
+
+	/* All sensors sample the belt at the end of this frame */
+	err = lgc_modbus_sync(seq);
+
+	for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+	{
+		if (!lgc_sensor_should_read(i, 1))
+		{
+			data.sensor_status |= (1 << i);
+		}
+		else if (err == NO_ERROR && lgc_modbus_read_sync(i + 1, seq, &data.sensor[i]) == NO_ERROR)
+		{
+			lgc_sensor_report(i, NO_ERROR);
+		}
+		else
+		{
+			lgc_sensor_report(i, lgc_read_sensor_slice(i, seq));
+		}
+	}
+
+	/* Process measurement, failed sensors estimated */
+	if (lgc_sensor_estimate())
+	{
+		lgc_process_slice(config);
+	}
+}
+
+static error_t lgc_read_sensor_slice(uint8_t sensor, uint16_t seq)
+{
+	error_t err;
+	lgc_modbus_slice_t slice;
+	uint16_t count = 0;
+
+	/* The sensor latched the broadcast even if its reply was lost */
+	err = lgc_modbus_read_history(sensor + 1, seq - 1, &slice, 1, &count);
+	if (err == NO_ERROR && count == 1 && slice.seq == seq)
+	{
+		data.sensor[sensor] = slice.value;
+		return NO_ERROR;
+	}
+
+	/* One live read, the health model retries on the next steps */
+	return lgc_modbus_read_holding_regs(sensor + 1, 45, &data.sensor[sensor], 1);
+}
+
+static error_t lgc_read_sensor_changes(uint8_t sensor, uint16_t steps)
+{
+	error_t err;
+	lgc_modbus_changes_t changes;
+	uint16_t since = history_seq - 1;
+	uint16_t seq;
+	uint16_t value;
+	uint16_t n = 0;
+	uint16_t j;
+
+	do
+	{
+		err = lgc_modbus_read_changes(sensor + 1, since, &changes, LGC_CHANGES_POLL);
+		if (err != NO_ERROR)
+		{
+			return err;
+		}
+
+		if (changes.lost)
+		{
+			/* Too many changes for the log, the slices are still in the ring */
+			return lgc_modbus_read_history(sensor + 1, history_seq - 1, history_slices[sensor], steps,
+										   &history_count[sensor]);
+		}
+
+		/* One slice per step up to head: base value, then every change from its seq on */
+		value = changes.base;
+		j = 0;
+		while (n < steps && (int16_t)((uint16_t)(history_seq + n) - changes.head) <= 0)
+		{
+			seq = history_seq + n;
+			while (j < changes.count && (int16_t)(changes.entry[j].seq - seq) <= 0)
+			{
+				value = changes.entry[j++].value;
+			}
+			history_slices[sensor][n].seq = seq;
+			history_slices[sensor][n].value = value;
+			history_slices[sensor][n].tick = 0;
+			n++;
+		}
+
+		if (changes.head == since)
+		{
+			break;
+		}
+		since = changes.head;
+	} while (changes.more && n < steps);
+
+	/* steps after head were not latched by the sensor */
+	history_count[sensor] = n;
+
+	return NO_ERROR;
+}
+
+static uint8_t lgc_sensor_should_read(uint8_t sensor, uint16_t steps)
+{
+	lgc_sensor_health_t *health = &data.health[sensor];
+
+	if (!health->quarantined)
+	{
+		return TRUE;
+	}
+
+	/* The backoff counts encoder steps, a burst covers several */
+	health->probe_in = (health->probe_in > steps) ? health->probe_in - steps : 0;
+
+	return (health->probe_in == 0) ? TRUE : FALSE;
+}
+
+static void lgc_sensor_report(uint8_t sensor, error_t err)
+{
+	lgc_sensor_health_t *health = &data.health[sensor];
+
+	if (err == NO_ERROR)
+	{
+		health->failures = 0;
+		health->quarantined = 0;
+		health->backoff = LGC_SENSOR_PROBE_MIN_STEPS;
+		data.sensor_status &= ~(1 << sensor);
+		return;
+	}
+
+	data.sensor_status |= (1 << sensor);
+	if (health->failures < UINT8_MAX)
+	{
+		health->failures++;
+	}
+
+	if (health->quarantined)
+	{
+		/* Failed probe: wait twice as long for the next one */
+		health->backoff = (health->backoff < LGC_SENSOR_PROBE_MAX_STEPS / 2) ? health->backoff * 2 : LGC_SENSOR_PROBE_MAX_STEPS;
+		health->probe_in = health->backoff;
+	}
+	else if (health->failures >= LGC_SENSOR_QUARANTINE_FAILS)
+	{
+		health->quarantined = 1;
+		health->backoff = LGC_SENSOR_PROBE_MIN_STEPS;
+		health->probe_in = health->backoff;
+	}
+}
+
+static uint8_t lgc_sensor_estimate(void)
+{
+	const uint16_t all = (1 << LGC_SENSOR_NUMBER) - 1;
+	const uint16_t pixels = (1 << LGC_PHOTORECEPTORS_PER_SENSOR) - 1;
+	lgc_sensor_health_t *health;
+	uint8_t known;
+	uint8_t covered;
+
+	data.sensor_estimated = data.sensor_status & all;
+
+	for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+	{
+		health = &data.health[i];
+
+		if ((data.sensor_estimated & (1 << i)) == 0)
+		{
+			health->last_good = data.sensor[i];
+			health->stale = 0;
+			continue;
+		}
+
+		if (health->stale < UINT16_MAX)
+		{
+			health->stale++;
+		}
+
+		if (health->stale <= LGC_SENSOR_HOLD_STEPS)
+		{
+			data.sensor[i] = health->last_good;
+			continue;
+		}
+
+		/* Leather under the sensor if the facing pixels of the read neighbours see it */
+		known = 0;
+		covered = 1;
+		if (i > 0 && (data.sensor_estimated & (1 << (i - 1))) == 0)
+		{
+			known = 1;
+			covered &= (data.sensor[i - 1] >> (LGC_PHOTORECEPTORS_PER_SENSOR - 1)) & 1;
+		}
+		if (i < LGC_SENSOR_NUMBER - 1 && (data.sensor_estimated & (1 << (i + 1))) == 0)
+		{
+			known = 1;
+			covered &= data.sensor[i + 1] & 1;
+		}
+		data.sensor[i] = (known && covered) ? pixels : 0;
+	}
+
+	return (data.sensor_estimated != all) ? TRUE : FALSE;
+}
+
+static void lgc_bus_setup(LGC_CONF_TypeDef_t *config)
 {
-	uint16_t active_bits = 0;
+	uint16_t missing = 0;
 
-	/* Iterate through all sensors */
+#if (LGC_MODBUS_SEGMENT_COUNT > 1)
+	/* Split the sensors between the segments (left half on segment 0) and
+	 * give every segment its own snapshot chain */
 	for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
 	{
-		/* Count set bits only in the first 10 bits (photoreceptors per sensor) */
-		uint16_t sensor_data = data.sensor[i];
+		lgc_modbus_segment_set(i + 1, (i * LGC_MODBUS_SEGMENT_COUNT) / LGC_SENSOR_NUMBER);
+	}
+	if (lgc_modbus_chain_setup(LGC_SENSOR_NUMBER, &missing) != NO_ERROR)
+	{
+		for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+		{
+			if (missing & (1 << i))
+			{
+				lgc_sensor_report(i, ERROR_TIMEOUT);
+			}
+		}
+	}
+	missing = 0;
+#endif
 
-		for (uint8_t bit = 0; bit < LGC_PHOTORECEPTORS_PER_SENSOR; bit++)
+	/* The controller boots at 9600: sensors still there follow the broadcast,
+	 * sensors already at the configured rate ignore it and answer the check */
+	if (config->baud != LGC_MODBUS_BAUD_9600 && config->baud < LGC_MODBUS_BAUD_MAX &&
+		lgc_modbus_baud_negotiate(config->baud, LGC_SENSOR_NUMBER, &missing) != NO_ERROR)
+	{
+		/* Bus stays at 9600, report the sensors that failed */
+		for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
 		{
-			if (sensor_data & (1 << bit))
+			if (missing & (1 << i))
 			{
-				active_bits++;
+				lgc_sensor_report(i, ERROR_TIMEOUT);
 			}
 		}
 	}
 
-	return active_bits;
+#if (LGC_SCAN_MODE == LGC_SCAN_FAST)
+	/* Tokens from now on, Modbus stays available for the rest */
+	lgc_modbus_fast_enable(TRUE);
+#endif
+}
+
+static void lgc_process_slice(LGC_CONF_TypeDef_t *config)
+{
+	uint8_t measurement_event; /* Event status from measurement processing */
+
+	// acquire measurements mutex
+	osAcquireMutex(&measurements.mutex);
+	/* Process measurement and get event status */
+	measurement_event = lgc_process_measurement(config);
+	// release measurements mutex
+	osReleaseMutex(&measurements.mutex);
+	/* Handle measurement events
+	 * 0: No event (still measuring or idle)
+	 * 1: Leather measurement completed
+	 * 2: Batch measurement completed
+	 */
+	if (measurement_event == 1)
+	{
+		/* TODO: Signal leather completion (e.g., update UI, log event) */
+
+		// set hmi flag
+		osSetEventBits(&events, LGC_HMI_UPDATE_REQUIRED);
+	}
+	else if (measurement_event == 2)
+	{
+		/* TODO: Signal batch completion (e.g., save to EEPROM, print results) */
+
+		// set hmi flag and printer event
+		osSetEventBits(&events, LGC_HMI_UPDATE_REQUIRED | LGC_EVENT_PRINT_BATCH);
+	}
+}
+
+/**
+ * @brief Count active bits (photoreceptors detecting leather) across all sensors
+ * @return uint16_t Number of active photoreceptors (0-110)
+ */
+static uint16_t lgc_count_active_bits(void)
+{
+	/* Only the first 10 bits of each sensor are photoreceptors */
+	lgc_module_slice_pack(&slice, data.sensor, LGC_SENSOR_NUMBER);
+
+	return lgc_module_slice_count(&slice);
 }
 
 /**
@@ -467,11 +973,13 @@ static uint8_t lgc_process_measurement(LGC_CONF_TypeDef_t *config)
 			 */
 			measurements.is_measuring = 1;
 			measurements.current_leather_area = 0.0f;
+			measurements.current_leather_estimated = 0;
 			measurements.no_detection_count = 0;
 		}
 
 		/* ACTION: Accumulate area while leather is detected */
 		measurements.current_leather_area += slice_area;
+		measurements.current_leather_estimated |= data.sensor_estimated;
 		measurements.no_detection_count = 0; /* Reset hysteresis counter */
 
 		event_status = 0; /* No event - still measuring */
@@ -502,6 +1010,9 @@ static uint8_t lgc_process_measurement(LGC_CONF_TypeDef_t *config)
 				{
 					measurements.leather_measurement[measurements.current_leather_index] =
 						measurements.current_leather_area;
+					/* Flag the hide if part of it was estimated */
+					measurements.leather_estimated[measurements.current_leather_index] =
+						measurements.current_leather_estimated;
 				}
 
 				/* ==================================================
@@ -531,6 +1042,8 @@ static uint8_t lgc_process_measurement(LGC_CONF_TypeDef_t *config)
 					memcpy(measurements.leather_measurement_last, measurements.leather_measurement, sizeof(float) * LGC_LEATHER_COUNT_MAX);
 					// clear last leather measurement
 					memset(measurements.leather_measurement, 0, sizeof(float) * LGC_LEATHER_COUNT_MAX);
+					memcpy(measurements.leather_estimated_last, measurements.leather_estimated, sizeof(measurements.leather_estimated));
+					memset(measurements.leather_estimated, 0, sizeof(measurements.leather_estimated));
 					// increment batch index
 					measurements.current_batch_index++;
 					// update return status
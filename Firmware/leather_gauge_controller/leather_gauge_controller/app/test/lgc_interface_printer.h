@@ -0,0 +1,11 @@
+/*
+ * lgc_interface_printer.h
+ *
+ * Host stand-in for modules/printer/lgc_interface_printer.h, which pulls in
+ * usbx. The main task uses none of it.
+ */
+
+#ifndef INTERFACES_PRINTER_lgc_8XL_INTERFACE_PRINTER_H_
+#define INTERFACES_PRINTER_lgc_8XL_INTERFACE_PRINTER_H_
+
+#endif /* INTERFACES_PRINTER_lgc_8XL_INTERFACE_PRINTER_H_ */
@@ -0,0 +1,295 @@
+/*
+ * lgc_main_task_test.c
+ *
+ * Host check of the history acquisition of the main task: runs of encoder
+ * steps that are not a multiple of LGC_HISTORY_BURST are started and
+ * stopped, and every step the sensors latched must reach the leather area,
+ * the partial burst of the stop included. The task runs unmodified on top
+ * of the stubs below (RTOS, GPIO, sensor bus with one history ring per
+ * sensor).
+ *
+ * Build and run from leather_gauge_controller:
+ *   gcc -O2 -DLGC_SCAN_MODE=LGC_SCAN_HISTORY -Iapp/test -Iapp/inc -Iconfig \
+ *       -Imodules/di -Imodules/eeprom -Imodules/encoder -Imodules/modbus \
+ *       -Imodules/rtc -Imodules/slice -Imiddlewares/at24cxx \
+ *       -Imiddlewares/lwbtn/src/include -Imiddlewares/lwbtn/src/include/lwbtn \
+ *       -Imiddlewares/nanoMODBUS -Iosal/common \
+ *       app/test/lgc_main_task_test.c app/src/lgc_main_task.c \
+ *       modules/slice/lgc_module_slice.c -lm -o main_task_test
+ *   ./main_task_test
+ *
+ * LGC_SCAN_CHANGES builds the same way; the change log stub reports an
+ * overflow so the task falls back to the history read.
+ *
+ * app/test also holds host stand-ins for os_port.h, main.h and
+ * lgc_interface_printer.h, which pull in the RTOS, the HAL and usbx.
+ */
+
+#include "lgc.h"
+#include "lgc_interface_modbus.h"
+#include "lgc_module_encoder.h"
+#include "lgc_module_rtc.h"
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+
+#define TEST_RING_SIZE 64
+/* Every pixel of every sensor covered: each step adds one full slice */
+#define TEST_VALUE 0x3FF
+#define TEST_SLICE_AREA (LGC_SENSOR_NUMBER * LGC_PHOTORECEPTORS_PER_SENSOR * 10.0f * 5.0f / 1000000.0f)
+
+OsEvent events;
+GPIO_TypeDef test_gpio;
+
+/* Runs of encoder steps, stopped after the last step of each */
+static const uint16_t runs[] = {13, 5, 16, 1, 7, 8};
+static uint8_t run_index = 0;
+static uint16_t steps_left = 0;
+static int fails = 0;
+static jmp_buf done;
+
+static void test_check_run(uint16_t steps);
+
+/* Sensor history rings, filled by the latch broadcast */
+static lgc_modbus_slice_t ring[LGC_SENSOR_NUMBER][TEST_RING_SIZE];
+static uint16_t ring_head = 0;
+static uint32_t latches = 0;
+
+/* ----------------------------------------------------------------------------
+ * RTOS: the stop/start events and the encoder flag follow the runs table
+ * ------------------------------------------------------------------------- */
+bool_t osCreateSemaphore(OsSemaphore *semaphore, uint_t count)
+{
+    *semaphore = count;
+    return TRUE;
+}
+
+bool_t osWaitForSemaphore(OsSemaphore *semaphore, systime_t timeout)
+{
+    (void)semaphore;
+
+    if (timeout == 0 || steps_left == 0)
+    {
+        return FALSE;
+    }
+    steps_left--;
+    return TRUE;
+}
+
+void osReleaseSemaphore(OsSemaphore *semaphore)
+{
+    (void)semaphore;
+}
+
+bool_t osCreateMutex(OsMutex *mutex)
+{
+    *mutex = 0;
+    return TRUE;
+}
+
+void osAcquireMutex(OsMutex *mutex)
+{
+    (void)mutex;
+}
+
+void osReleaseMutex(OsMutex *mutex)
+{
+    (void)mutex;
+}
+
+bool_t osSetEventBits(OsEvent *event, uint32_t mask)
+{
+    *event |= mask;
+    return TRUE;
+}
+
+bool_t osWaitForEventBits(OsEvent *event, uint32_t mask, bool_t wait_all, bool_t clear_on_exit, systime_t timeout)
+{
+    (void)event;
+    (void)wait_all;
+    (void)clear_on_exit;
+    (void)timeout;
+
+    if (mask & LGC_EVENT_START)
+    {
+        /* Stopped: check the run that just ended, then start the next one */
+        if (run_index > 0)
+        {
+            test_check_run(runs[run_index - 1]);
+        }
+        if (run_index == sizeof(runs) / sizeof(runs[0]))
+        {
+            longjmp(done, 1);
+        }
+        steps_left = runs[run_index++];
+        return TRUE;
+    }
+    if (mask & LGC_EVENT_STOP)
+    {
+        /* Running: stop right after the last step of the run */
+        return (steps_left == 0) ? TRUE : FALSE;
+    }
+    return FALSE;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    GPIOx->odr = (PinState == GPIO_PIN_SET) ? (GPIOx->odr | GPIO_Pin) : (GPIOx->odr & ~GPIO_Pin);
+}
+
+/* ----------------------------------------------------------------------------
+ * modules
+ * ------------------------------------------------------------------------- */
+error_t lgc_module_conf_get(LGC_CONF_TypeDef_t *obj)
+{
+    memset(obj, 0, sizeof(*obj));
+    /* areas in m2 */
+    obj->units = 1;
+    return NO_ERROR;
+}
+
+error_t lgc_module_conf_set(LGC_CONF_TypeDef_t *obj)
+{
+    (void)obj;
+    return NO_ERROR;
+}
+
+error_t lgc_module_encoder_init(lgc_module_encoder_callback_cb_t callback)
+{
+    (void)callback;
+    return NO_ERROR;
+}
+
+error_t lgc_module_rtc_init(const RTC_Config_t *config)
+{
+    (void)config;
+    return NO_ERROR;
+}
+
+/* ----------------------------------------------------------------------------
+ * sensor bus: every sensor latches every broadcast
+ * ------------------------------------------------------------------------- */
+error_t lgc_modbus_xfer_init(lgc_modbus_xfer_t *xfer)
+{
+    memset(xfer, 0, sizeof(*xfer));
+    return NO_ERROR;
+}
+
+error_t lgc_modbus_submit(lgc_modbus_xfer_t *xfer)
+{
+    (void)xfer;
+    return ERROR_NOT_IMPLEMENTED;
+}
+
+error_t lgc_modbus_wait(lgc_modbus_xfer_t *xfer, systime_t timeout)
+{
+    (void)xfer;
+    (void)timeout;
+    return ERROR_NOT_IMPLEMENTED;
+}
+
+error_t lgc_modbus_baud_negotiate(uint8_t code, uint8_t count, uint16_t *missing)
+{
+    (void)code;
+    (void)count;
+    *missing = 0;
+    return NO_ERROR;
+}
+
+error_t lgc_modbus_latch(uint16_t seq)
+{
+    for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+    {
+        ring[i][ring_head % TEST_RING_SIZE].seq = seq;
+        ring[i][ring_head % TEST_RING_SIZE].value = TEST_VALUE;
+        ring[i][ring_head % TEST_RING_SIZE].tick = 0;
+    }
+    ring_head++;
+    latches++;
+    return NO_ERROR;
+}
+
+error_t lgc_modbus_read_history(uint8_t dev, uint16_t since, lgc_modbus_slice_t *slices, size_t max, uint16_t *count)
+{
+    uint16_t first = (ring_head > TEST_RING_SIZE) ? ring_head - TEST_RING_SIZE : 0;
+
+    *count = 0;
+    for (uint16_t k = first; k < ring_head && *count < max; k++)
+    {
+        /* slices after since, oldest first */
+        if ((int16_t)(ring[dev - 1][k % TEST_RING_SIZE].seq - since) > 0)
+        {
+            slices[(*count)++] = ring[dev - 1][k % TEST_RING_SIZE];
+        }
+    }
+    return NO_ERROR;
+}
+
+error_t lgc_modbus_read_changes(uint8_t dev, uint16_t since, lgc_modbus_changes_t *changes, size_t max)
+{
+    (void)dev;
+    (void)since;
+    (void)max;
+    memset(changes, 0, sizeof(*changes));
+    changes->lost = 1;
+    return NO_ERROR;
+}
+
+error_t lgc_modbus_read_holding_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len)
+{
+    (void)dev;
+    (void)address;
+    (void)regs;
+    (void)len;
+    return ERROR_TIMEOUT;
+}
+
+error_t lgc_modbus_sync(uint16_t id)
+{
+    (void)id;
+    return ERROR_NOT_IMPLEMENTED;
+}
+
+error_t lgc_modbus_read_sync(uint8_t dev, uint16_t id, uint16_t *value)
+{
+    (void)dev;
+    (void)id;
+    (void)value;
+    return ERROR_NOT_IMPLEMENTED;
+}
+
+/* ----------------------------------------------------------------------------
+ * test
+ * ------------------------------------------------------------------------- */
+static void test_check_run(uint16_t steps)
+{
+    static lgc_measurements_t m;
+    static float area = 0.0f;
+    static uint32_t latched = 0;
+    float counted;
+
+    /* The task leaves the leather open between runs (always covered), so
+     * the area of a run is the growth of the current leather */
+    lgc_get_measurements(&m);
+    counted = (m.current_leather_area - area) / TEST_SLICE_AREA;
+    area = m.current_leather_area;
+
+    printf("run of %2u steps: %2u latched, %5.2f counted  %s\n", steps, (unsigned)(latches - latched), counted,
+           (latches - latched == steps && fabsf(counted - steps) < 0.01f) ? "ok" : "FAIL");
+    if (latches - latched != steps || fabsf(counted - steps) >= 0.01f)
+    {
+        fails++;
+    }
+    latched = latches;
+}
+
+int main(void)
+{
+    if (setjmp(done) == 0)
+    {
+        lgc_main_task_entry(NULL);
+    }
+
+    printf("%s\n", fails ? "FAIL" : "PASS");
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * main.h
+ *
+ * Host stand-in for Core/Inc/main.h: the output pins the main task drives.
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include <stdint.h>
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct
+{
+	uint32_t odr;
+} GPIO_TypeDef;
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+
+extern GPIO_TypeDef test_gpio;
+
+#define DO_0_GPIO_Port (&test_gpio)
+#define DO_0_Pin 0x0001
+#define DO_1_GPIO_Port (&test_gpio)
+#define DO_1_Pin 0x0002
+#define D0_2_GPIO_Port (&test_gpio)
+#define D0_2_Pin 0x0004
+#define D0_6_GPIO_Port (&test_gpio)
+#define D0_6_Pin 0x0040
+#define D0_7_GPIO_Port (&test_gpio)
+#define D0_7_Pin 0x0080
+
+#endif /* __MAIN_H */
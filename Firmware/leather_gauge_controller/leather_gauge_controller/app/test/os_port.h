@@ -0,0 +1,44 @@
+/*
+ * os_port.h
+ *
+ * Host stand-in for osal/include/os_port.h: the types and calls the main
+ * task uses, implemented by the test. Keep in step with the threadx port.
+ */
+
+#ifndef _OS_PORT_H
+#define _OS_PORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#define INFINITE_DELAY ((uint_t)-1)
+
+typedef unsigned int uint_t;
+typedef int bool_t;
+typedef uint32_t systime_t;
+
+typedef uint32_t OsEvent;
+typedef uint_t OsSemaphore;
+typedef uint_t OsMutex;
+
+bool_t osCreateSemaphore(OsSemaphore *semaphore, uint_t count);
+bool_t osWaitForSemaphore(OsSemaphore *semaphore, systime_t timeout);
+void osReleaseSemaphore(OsSemaphore *semaphore);
+
+bool_t osCreateMutex(OsMutex *mutex);
+void osAcquireMutex(OsMutex *mutex);
+void osReleaseMutex(OsMutex *mutex);
+
+bool_t osSetEventBits(OsEvent *event, uint32_t mask);
+bool_t osWaitForEventBits(OsEvent *event, uint32_t mask, bool_t wait_all, bool_t clear_on_exit, systime_t timeout);
+
+#endif /* _OS_PORT_H */
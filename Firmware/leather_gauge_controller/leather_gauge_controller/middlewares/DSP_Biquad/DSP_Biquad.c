@@ -8,6 +8,59 @@
 #define M_PI 3.14159265358979323846f
 #endif
 
+/* 1.0 en Q30 */
+#define BIQUAD_Q30_ONE ((int32_t)1 << 30)
+
+/* sin(i * pi / 512) en Q30, i = 0..256 (un cuarto de onda) */
+static const int32_t biquad_sin_q30[257] = {
+    0, 6588356, 13176464, 19764076, 26350943, 32936819,
+    39521455, 46104602, 52686014, 59265442, 65842639, 72417357,
+    78989349, 85558366, 92124163, 98686491, 105245103, 111799753,
+    118350194, 124896179, 131437462, 137973796, 144504935, 151030634,
+    157550647, 164064728, 170572633, 177074115, 183568930, 190056834,
+    196537583, 203010932, 209476638, 215934457, 222384147, 228825464,
+    235258165, 241682010, 248096755, 254502159, 260897982, 267283981,
+    273659918, 280025552, 286380643, 292724951, 299058239, 305380268,
+    311690799, 317989595, 324276419, 330551034, 336813204, 343062693,
+    349299266, 355522689, 361732726, 367929144, 374111709, 380280190,
+    386434353, 392573967, 398698801, 404808624, 410903207, 416982319,
+    423045732, 429093217, 435124548, 441139496, 447137835, 453119340,
+    459083786, 465030947, 470960600, 476872522, 482766489, 488642281,
+    494499676, 500338453, 506158392, 511959275, 517740883, 523502998,
+    529245404, 534967884, 540670223, 546352205, 552013618, 557654248,
+    563273883, 568872310, 574449320, 580004702, 585538248, 591049748,
+    596538995, 602005783, 607449906, 612871159, 618269338, 623644239,
+    628995660, 634323400, 639627258, 644907034, 650162530, 655393548,
+    660599890, 665781362, 670937767, 676068911, 681174602, 686254647,
+    691308855, 696337036, 701339000, 706314559, 711263525, 716185713,
+    721080937, 725949013, 730789757, 735602987, 740388522, 745146182,
+    749875788, 754577161, 759250125, 763894504, 768510122, 773096806,
+    777654384, 782182683, 786681534, 791150767, 795590213, 799999706,
+    804379079, 808728167, 813046808, 817334838, 821592095, 825818421,
+    830013654, 834177638, 838310216, 842411232, 846480531, 850517961,
+    854523370, 858496606, 862437520, 866345964, 870221790, 874064853,
+    877875009, 881652112, 885396022, 889106597, 892783698, 896427186,
+    900036924, 903612776, 907154608, 910662286, 914135678, 917574653,
+    920979082, 924348837, 927683790, 930983817, 934248793, 937478595,
+    940673101, 943832191, 946955747, 950043650, 953095785, 956112036,
+    959092290, 962036435, 964944360, 967815955, 970651112, 973449725,
+    976211688, 978936898, 981625251, 984276646, 986890984, 989468165,
+    992008094, 994510675, 996975812, 999403415, 1001793390, 1004145648,
+    1006460100, 1008736660, 1010975242, 1013175761, 1015338134, 1017462281,
+    1019548121, 1021595575, 1023604567, 1025575020, 1027506862, 1029400018,
+    1031254418, 1033069992, 1034846671, 1036584389, 1038283080, 1039942680,
+    1041563127, 1043144360, 1044686319, 1046188946, 1047652185, 1049075980,
+    1050460278, 1051805027, 1053110176, 1054375676, 1055601479, 1056787540,
+    1057933813, 1059040255, 1060106826, 1061133483, 1062120190, 1063066909,
+    1063973603, 1064840240, 1065666786, 1066453210, 1067199483, 1067905576,
+    1068571464, 1069197120, 1069782521, 1070327646, 1070832474, 1071296985,
+    1071721163, 1072104991, 1072448455, 1072751542, 1073014240, 1073236540,
+    1073418433, 1073559913, 1073660973, 1073721611, 1073741824,
+};
+
+static int32_t BiquadQ_Sin(uint32_t phase);
+static int32_t BiquadQ_Norm(int64_t num, int64_t a0);
+
 void Biquad_Init(Biquad_t *f, BiquadFilterType type, float fc, float fs, float Q) {
     // Limpiamos memoria de estado
     Biquad_Reset(f);
@@ -97,3 +150,204 @@ float Biquad_Apply(Biquad_t *f, float x) {
 
     return y;
 }
+
+void Biquad_ApplyBlock(Biquad_t *f, const float *x, float *y, uint32_t n) {
+    // Coeficientes e historia en variables locales durante todo el bloque
+    const float b0 = f->b0, b1 = f->b1, b2 = f->b2;
+    const float a1 = f->a1, a2 = f->a2;
+    float x1 = f->x1, x2 = f->x2;
+    float y1 = f->y1, y2 = f->y2;
+    float xn, yn;
+
+    for (uint32_t i = 0; i < n; i++) {
+        xn = x[i];
+        yn = (b0 * xn) + (b1 * x1) + (b2 * x2) - (a1 * y1) - (a2 * y2);
+        x2 = x1;
+        x1 = xn;
+        y2 = y1;
+        y1 = yn;
+        y[i] = yn;
+    }
+
+    f->x1 = x1;
+    f->x2 = x2;
+    f->y1 = y1;
+    f->y2 = y2;
+}
+
+/*
+ * Seno de una fase en fracciones de vuelta (2^32 = 2*pi), resultado en Q30.
+ */
+static int32_t BiquadQ_Sin(uint32_t phase) {
+    uint32_t quadrant = phase >> 30;
+    uint32_t pos = phase & 0x3FFFFFFFUL;
+    uint32_t idx;
+    uint32_t frac;
+    int32_t s;
+
+    // Segundo y cuarto cuadrante: el cuarto de onda recorrido al revés
+    if (quadrant & 1U) {
+        pos = 0x40000000UL - pos;
+    }
+    idx = pos >> 22;
+    frac = pos & 0x3FFFFFUL;
+
+    s = biquad_sin_q30[idx];
+    if (idx < 256U) {
+        s += (int32_t)(((int64_t)(biquad_sin_q30[idx + 1] - s) * frac) >> 22);
+    }
+
+    return (quadrant & 2U) ? -s : s;
+}
+
+/*
+ * Normaliza un coeficiente Q30 por a0 (Q30), resultado en Q(BIQUAD_Q_COEF_FRAC).
+ */
+static int32_t BiquadQ_Norm(int64_t num, int64_t a0) {
+    return (int32_t)(num * ((int64_t)1 << BIQUAD_Q_COEF_FRAC) / a0);
+}
+
+void BiquadQ_Init(BiquadQ_t *f, BiquadFilterType type, uint32_t fc_x10, uint32_t fs, uint32_t q_x1000) {
+    // Limpiamos memoria de estado
+    BiquadQ_Reset(f);
+
+    // Fase w0 en fracciones de vuelta: fc / fs * 2^32
+    uint64_t phase = (fs != 0) ? ((uint64_t)fc_x10 << 32) / ((uint64_t)fs * 10U) : 0;
+
+    if (phase == 0 || phase >= 0x80000000ULL || q_x1000 == 0) {
+        // fc nula o por encima de Nyquist: Pass-Through (sin filtro)
+        f->b0 = (int32_t)1 << BIQUAD_Q_COEF_FRAC; f->b1 = 0; f->b2 = 0;
+        f->a1 = 0; f->a2 = 0;
+        return;
+    }
+
+    // 1 - cos(w0) = 2*sin^2(w0/2): exacto aun con fc muy bajas
+    int32_t s_half = BiquadQ_Sin((uint32_t)(phase >> 1));
+    int64_t one_minus_cos = ((int64_t)s_half * s_half) >> 29;
+    int64_t cos_w0 = BIQUAD_Q30_ONE - one_minus_cos;
+    int64_t alpha = (int64_t)BiquadQ_Sin((uint32_t)phase) * 500 / q_x1000;
+
+    // Coeficientes sin normalizar, Q30
+    int64_t b0_t, b1_t, b2_t, a0_t, a1_t, a2_t;
+
+    switch (type) {
+        case BQ_LOWPASS:
+            b0_t = one_minus_cos / 2;
+            b1_t = one_minus_cos;
+            b2_t = one_minus_cos / 2;
+            break;
+
+        case BQ_HIGHPASS:
+            b0_t = (BIQUAD_Q30_ONE + cos_w0) / 2;
+            b1_t = -(BIQUAD_Q30_ONE + cos_w0);
+            b2_t = (BIQUAD_Q30_ONE + cos_w0) / 2;
+            break;
+
+        case BQ_BANDPASS:
+            b0_t = alpha;
+            b1_t = 0;
+            b2_t = -alpha;
+            break;
+
+        case BQ_NOTCH:
+            b0_t = BIQUAD_Q30_ONE;
+            b1_t = -2 * cos_w0;
+            b2_t = BIQUAD_Q30_ONE;
+            break;
+
+        default:
+            // Por defecto Pass-Through (sin filtro)
+            f->b0 = (int32_t)1 << BIQUAD_Q_COEF_FRAC; f->b1 = 0; f->b2 = 0;
+            f->a1 = 0; f->a2 = 0;
+            return;
+    }
+    a0_t = BIQUAD_Q30_ONE + alpha;
+    a1_t = -2 * cos_w0;
+    a2_t = BIQUAD_Q30_ONE - alpha;
+
+    // Normalización: Dividimos todo por a0 (para que a0 sea 1 en la formula final)
+    f->b0 = BiquadQ_Norm(b0_t, a0_t);
+    f->b1 = BiquadQ_Norm(b1_t, a0_t);
+    f->b2 = BiquadQ_Norm(b2_t, a0_t);
+    f->a1 = BiquadQ_Norm(a1_t, a0_t);
+    f->a2 = BiquadQ_Norm(a2_t, a0_t);
+}
+
+void BiquadQ_Reset(BiquadQ_t *f) {
+    f->x1 = 0;
+    f->x2 = 0;
+    f->y1 = 0;
+    f->y2 = 0;
+}
+
+int32_t BiquadQ_Apply(BiquadQ_t *f, int32_t x) {
+    // Misma ecuación que Biquad_Apply (Direct Form I), todo entero
+    BiquadQAcc_t acc;
+    int32_t y;
+
+    x = x * ((int32_t)1 << BIQUAD_Q_OUT_FRAC);
+
+    acc = (BiquadQAcc_t)f->b0 * x + (BiquadQAcc_t)f->b1 * f->x1 + (BiquadQAcc_t)f->b2 * f->x2
+          - (BiquadQAcc_t)f->a1 * f->y1 - (BiquadQAcc_t)f->a2 * f->y2;
+
+    // Vuelta a Q(BIQUAD_Q_OUT_FRAC) con redondeo y saturación
+    acc = (acc + ((BiquadQAcc_t)1 << (BIQUAD_Q_COEF_FRAC - 1))) >> BIQUAD_Q_COEF_FRAC;
+    if (acc > BIQUAD_Q_STATE_MAX) {
+        acc = BIQUAD_Q_STATE_MAX;
+    } else if (acc < -BIQUAD_Q_STATE_MAX) {
+        acc = -BIQUAD_Q_STATE_MAX;
+    }
+    y = (int32_t)acc;
+
+    // Desplazar historia (shift buffer)
+    f->x2 = f->x1;
+    f->x1 = x;
+
+    f->y2 = f->y1;
+    f->y1 = y;
+
+#if (BIQUAD_Q_OUT_FRAC > 0)
+    return (y + ((int32_t)1 << (BIQUAD_Q_OUT_FRAC - 1))) >> BIQUAD_Q_OUT_FRAC;
+#else
+    return y;
+#endif
+}
+
+void BiquadQ_ApplyBlock(BiquadQ_t *f, const int32_t *x, int32_t *y, uint32_t n) {
+    // Coeficientes e historia en variables locales durante todo el bloque
+    const int32_t b0 = f->b0, b1 = f->b1, b2 = f->b2;
+    const int32_t a1 = f->a1, a2 = f->a2;
+    int32_t x1 = f->x1, x2 = f->x2;
+    int32_t y1 = f->y1, y2 = f->y2;
+    BiquadQAcc_t acc;
+    int32_t xn;
+
+    for (uint32_t i = 0; i < n; i++) {
+        xn = x[i] * ((int32_t)1 << BIQUAD_Q_OUT_FRAC);
+
+        acc = (BiquadQAcc_t)b0 * xn + (BiquadQAcc_t)b1 * x1 + (BiquadQAcc_t)b2 * x2
+              - (BiquadQAcc_t)a1 * y1 - (BiquadQAcc_t)a2 * y2;
+        acc = (acc + ((BiquadQAcc_t)1 << (BIQUAD_Q_COEF_FRAC - 1))) >> BIQUAD_Q_COEF_FRAC;
+        if (acc > BIQUAD_Q_STATE_MAX) {
+            acc = BIQUAD_Q_STATE_MAX;
+        } else if (acc < -BIQUAD_Q_STATE_MAX) {
+            acc = -BIQUAD_Q_STATE_MAX;
+        }
+
+        x2 = x1;
+        x1 = xn;
+        y2 = y1;
+        y1 = (int32_t)acc;
+
+#if (BIQUAD_Q_OUT_FRAC > 0)
+        y[i] = (y1 + ((int32_t)1 << (BIQUAD_Q_OUT_FRAC - 1))) >> BIQUAD_Q_OUT_FRAC;
+#else
+        y[i] = y1;
+#endif
+    }
+
+    f->x1 = x1;
+    f->x2 = x2;
+    f->y1 = y1;
+    f->y2 = y2;
+}
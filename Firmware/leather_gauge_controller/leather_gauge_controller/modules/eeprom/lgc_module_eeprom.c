@@ -6,46 +6,55 @@
  */
 
 #include "lgc_module_eeprom.h"
+#include "lgc_interface_modbus.h"
 #include "os_port.h"
+#include "checksum.h"
 #include <stdint.h>
 #include <stddef.h>
 #include <string.h>
 
-#define CRC32_POLYNOMIAL 0x04C11DB7UL
+/*layout written by firmware without the baud field*/
+typedef struct __attribute__((__packed__))
+{
+    char client_name[12];
+    char color[10];
+    char leather_id[20];
+    uint32_t batch;
+    uint8_t units;
+    uint8_t conversion;
+    uint32_t crc;
+} LGC_CONF_V0_TypeDef_t;
 /*global variables*/
 static OsMutex mutex;
 static at24cxx_handle_t eeprom;
 static LGC_CONF_TypeDef_t lgc_conf = {0};
 
-/* static CRC32 (IEEE 802.3) implementation - table driven */
-static uint32_t lgc_crc32_compute(const uint8_t *data, size_t length)
+/* convert a configuration stored with the previous layout, mutex held */
+static error_t lgc_module_conf_migrate(void)
 {
-    uint32_t crc = 0xFFFFFFFFUL;
-    size_t i, j;
+    LGC_CONF_V0_TypeDef_t old;
 
-    if (data == NULL || length == 0)
+    if (at24cxx_read(&eeprom, 0x0000, (uint8_t *)&old, sizeof(LGC_CONF_V0_TypeDef_t)) != NO_ERROR)
     {
-        return 0;
+        return ERROR_FAILURE;
     }
 
-    for (i = 0; i < length; ++i)
+    if (checksum_crc32((uint8_t *)&old, sizeof(LGC_CONF_V0_TypeDef_t) - sizeof(uint32_t)) != old.crc)
     {
-        crc ^= data[i];
-        for (j = 0; j < 8; ++j)
-        {
-            if (crc & 1)
-            {
-                crc = (crc >> 1) ^ CRC32_POLYNOMIAL;
-            }
-            else
-            {
-                crc >>= 1;
-            }
-        }
+        return ERROR_FAILURE;
     }
 
-    crc = crc ^ 0xFFFFFFFFUL;
-    return crc;
+    memset(&lgc_conf, 0, sizeof(LGC_CONF_TypeDef_t));
+    memcpy(lgc_conf.client_name, old.client_name, sizeof(lgc_conf.client_name));
+    memcpy(lgc_conf.color, old.color, sizeof(lgc_conf.color));
+    memcpy(lgc_conf.leather_id, old.leather_id, sizeof(lgc_conf.leather_id));
+    lgc_conf.batch = old.batch;
+    lgc_conf.units = old.units;
+    lgc_conf.conversion = old.conversion;
+    lgc_conf.baud = LGC_MODBUS_BAUD_DEFAULT;
+    lgc_conf.crc = checksum_crc32((uint8_t *)&lgc_conf, sizeof(LGC_CONF_TypeDef_t) - sizeof(uint32_t));
+
+    return at24cxx_write(&eeprom, 0x0000, (uint8_t *)&lgc_conf, sizeof(LGC_CONF_TypeDef_t));
 }
 
 /*public functions*/
@@ -99,7 +108,7 @@ error_t lgc_module_conf_set(LGC_CONF_TypeDef_t *obj)
     /*lock mutex*/
     osAcquireMutex(&mutex);
     /*calculate crc*/
-    crc = lgc_crc32_compute((uint8_t *)obj, sizeof(LGC_CONF_TypeDef_t) - sizeof(uint32_t));
+    crc = checksum_crc32((uint8_t *)obj, sizeof(LGC_CONF_TypeDef_t) - sizeof(uint32_t));
     obj->crc = crc;
     /*copy conf*/
     memcpy(&lgc_conf, obj, sizeof(LGC_CONF_TypeDef_t));
@@ -129,17 +138,25 @@ error_t lgc_module_conf_load(void)
         return ERROR_FAILURE;
     }
     /*calculate crc*/
-    crc = lgc_crc32_compute((uint8_t *)&lgc_conf, sizeof(LGC_CONF_TypeDef_t) - sizeof(uint32_t));
-    /*verify crc*/
+    crc = checksum_crc32((uint8_t *)&lgc_conf, sizeof(LGC_CONF_TypeDef_t) - sizeof(uint32_t));
+    /*verify crc, then try the previous layout*/
+    if (crc != lgc_conf.crc && lgc_module_conf_migrate() == NO_ERROR)
+    {
+        /*release mutex*/
+        osReleaseMutex(&mutex);
+
+        return NO_ERROR;
+    }
     if (crc != lgc_conf.crc)
     {
         /*restore default*/
         memset(&lgc_conf, 0, sizeof(LGC_CONF_TypeDef_t));
         lgc_conf.batch = 10;
         lgc_conf.units = 0;
+        lgc_conf.baud = LGC_MODBUS_BAUD_DEFAULT;
         // todo: add
 
-        crc = lgc_crc32_compute((uint8_t *)&lgc_conf, sizeof(LGC_CONF_TypeDef_t) - sizeof(uint32_t));
+        crc = checksum_crc32((uint8_t *)&lgc_conf, sizeof(LGC_CONF_TypeDef_t) - sizeof(uint32_t));
         lgc_conf.crc = crc;
         /*write to eeprom*/
         at24cxx_write(&eeprom, 0x0000, (uint8_t *)&lgc_conf, sizeof(LGC_CONF_TypeDef_t));
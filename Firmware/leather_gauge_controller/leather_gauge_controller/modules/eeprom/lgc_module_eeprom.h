@@ -41,6 +41,8 @@ typedef struct __attribute__((__packed__)) LGC_CONF_TypeDef
     uint8_t units;
     /*unit conversion*/
     uint8_t conversion;
+    /*sensor bus baud rate code (lgc_modbus_baud_t)*/
+    uint8_t baud;
     /*crc*/
     uint32_t crc;
 
@@ -13,36 +13,171 @@
 /* ============================================================================
  * INCLUDES
  * ============================================================================ */
+#include <string.h>
 #include "lgc_interface_modbus.h"
 #include "nanomodbus.h"
+#include "checksum.h"
 #include "usart.h"
-#include "lwrb.h"
+#include "stm32_log.h"
 
 /* ============================================================================
  * DEFINES
  * ============================================================================ */
-#ifndef NMBS_READ_TIMEOUT
-#define NMBS_READ_TIMEOUT 100
+/* Sensor reply delay for reads and for writes (writes hit the sensor flash), milliseconds */
+#ifndef LGC_MODBUS_TURNAROUND_MS
+#define LGC_MODBUS_TURNAROUND_MS 20
+#endif
+
+#ifndef LGC_MODBUS_WRITE_TURNAROUND_MS
+#define LGC_MODBUS_WRITE_TURNAROUND_MS 100
 #endif
 
 #ifndef NMBS_WRITE_TIMEOUT
 #define NMBS_WRITE_TIMEOUT 1000
 #endif
 
+/* Circular DMA buffer, holds a few complete RTU frames (max 256 bytes each) */
 #ifndef MODBUS_RX_BUFFER_SIZE
-#define MODBUS_RX_BUFFER_SIZE 128
+#define MODBUS_RX_BUFFER_SIZE 512
+#endif
+
+/* Received frames waiting for the modbus task (power of two) */
+#ifndef MODBUS_RX_FRAMES
+#define MODBUS_RX_FRAMES 16
+#endif
+
+#ifndef LGC_MODBUS_TASK_PRI
+#define LGC_MODBUS_TASK_PRI 8
+#endif
+
+#ifndef LGC_MODBUS_TASK_STACK
+#define LGC_MODBUS_TASK_STACK 256
+#endif
+
+/* Transactions that can wait for the bus */
+#ifndef LGC_MODBUS_XFER_QUEUE_SIZE
+#define LGC_MODBUS_XFER_QUEUE_SIZE 8
+#endif
+
+/* Guard added to every snapshot reply slot (sensor turnaround), microseconds */
+#ifndef LGC_MODBUS_SNAPSHOT_GUARD_US
+#define LGC_MODBUS_SNAPSHOT_GUARD_US 500
+#endif
+
+/* Extra time allowed for a snapshot on top of the reply slots, milliseconds */
+#ifndef LGC_MODBUS_SNAPSHOT_MARGIN_MS
+#define LGC_MODBUS_SNAPSHOT_MARGIN_MS 20
+#endif
+
+/* Delay between the baud switch broadcast and the switch, milliseconds */
+#ifndef LGC_MODBUS_BAUD_SWITCH_MS
+#define LGC_MODBUS_BAUD_SWITCH_MS 50
 #endif
 
+/* Extra wait after the switch point before talking at the new rate */
+#ifndef LGC_MODBUS_BAUD_SETTLE_MS
+#define LGC_MODBUS_BAUD_SETTLE_MS 10
+#endif
+
+/* Time an uncommitted sensor keeps the new rate (LG_BAUD_TRIAL_MS on the sensor) */
+#ifndef LGC_MODBUS_BAUD_TRIAL_MS
+#define LGC_MODBUS_BAUD_TRIAL_MS 2000
+#endif
+
+/* Attempts per sensor to verify/commit the new rate */
+#ifndef LGC_MODBUS_BAUD_RETRY
+#define LGC_MODBUS_BAUD_RETRY 3
+#endif
+
+/* Second segment: a UART set up like USART3 (RX DMA circular, idle line)
+ * and the DE pin of its transceiver, e.g. huart4 / DIR_SENSORES_2 */
+#if (LGC_MODBUS_SEGMENT_COUNT > 2)
+#error "only two RS-485 segments are described below"
+#elif (LGC_MODBUS_SEGMENT_COUNT > 1)
+#if !defined(LGC_MODBUS_SEGMENT1_UART) || !defined(LGC_MODBUS_SEGMENT1_DE_PORT) || !defined(LGC_MODBUS_SEGMENT1_DE_PIN)
+#error "define LGC_MODBUS_SEGMENT1_UART, LGC_MODBUS_SEGMENT1_DE_PORT and LGC_MODBUS_SEGMENT1_DE_PIN"
+#endif
+#endif
+
+/* A history reply [addr][fc][byte count][registers][crc] is one FC23 read
+ * (max 125 registers) and must fit the rx ring with room for the next frame */
+#define LGC_MODBUS_HIST_REPLY_LEN (5 + 2 * (2 + LGC_MODBUS_HIST_SLICE_REGS * LGC_MODBUS_HIST_SLICES_MAX))
+#if (2 + LGC_MODBUS_HIST_SLICE_REGS * LGC_MODBUS_HIST_SLICES_MAX > 125)
+#error "LGC_MODBUS_HIST_SLICES_MAX exceeds one FC23 read"
+#endif
+#if (LGC_MODBUS_HIST_REPLY_LEN > MODBUS_RX_BUFFER_SIZE / 2)
+#error "LGC_MODBUS_HIST_SLICES_MAX does not fit MODBUS_RX_BUFFER_SIZE"
+#endif
+
+/* Change log replies are read into the history buffer */
+#if (LGC_MODBUS_CHG_HEADER_REGS + LGC_MODBUS_CHG_ENTRY_REGS * LGC_MODBUS_CHG_ENTRIES_MAX > \
+	 2 + LGC_MODBUS_HIST_SLICE_REGS * LGC_MODBUS_HIST_SLICES_MAX)
+#error "LGC_MODBUS_CHG_ENTRIES_MAX does not fit the history buffer"
+#endif
+
+/* ============================================================================
+ * TYPEDEFS
+ * ============================================================================ */
+/* One received frame inside the circular DMA buffer */
+typedef struct
+{
+	uint16_t start;
+	uint16_t len;
+	uint32_t stamp; /* DWT stamp of the end of the frame */
+} lgc_modbus_span_t;
+
+/* One RS-485 segment: its UART, DE pin, and everything its bus task owns */
+typedef struct
+{
+	/*hardware*/
+	UART_HandleTypeDef *huart;
+	GPIO_TypeDef *de_port;
+	uint16_t de_pin;
+	const char *name;
+	uint8_t index;
+	/*bus task*/
+	nmbs_platform_conf platform_conf;
+	nmbs_t nmbs;
+	OsQueue xfer_queue;
+	OsTaskId task;
+	uint16_t missing; /* sensors of this segment missed by the running transaction */
+	/*reception*/
+	uint8_t rx_dma[MODBUS_RX_BUFFER_SIZE];
+	lgc_modbus_span_t rx_frames[MODBUS_RX_FRAMES];
+	volatile uint16_t rx_wr;   /* frames posted by the idle-line callback */
+	volatile uint16_t rx_rd;   /* frames taken by the bus task */
+	uint16_t rx_frame_start;   /* dma index where the running frame started */
+	lgc_modbus_span_t rx_span; /* frame being handed to nanoMODBUS */
+	OsSemaphore rx_semaphore;
+	/*line timing*/
+	volatile uint32_t line_cycles; /* DWT stamp of the last bus activity */
+	uint32_t t35_cycles;		   /* t3.5 in core cycles at the current rate */
+	uint32_t char_cycles;		   /* one character in core cycles */
+	uint8_t baud_code;
+	/*statistics*/
+	uint32_t tx_cycles;	  /* DWT stamp of the end of our last frame */
+	uint32_t rx_cycles;	  /* DWT stamp of the end of the last frame handed to nanoMODBUS */
+	uint32_t scan_cycles; /* DWT stamp of the start of the previous scan */
+	systime_t scan_time;  /* system time of the start of the previous scan */
+	uint16_t history_regs[2 + LGC_MODBUS_HIST_SLICE_REGS * LGC_MODBUS_HIST_SLICES_MAX];
+} lgc_modbus_segment_t;
+
 /* ============================================================================
  * GLOBAL VARIABLES
  * ============================================================================ */
-static nmbs_platform_conf platform_conf;
-static nmbs_t nmbs;
-static OsMutex mutex;
-static lwrb_t modbus_rx_rb;
-static uint8_t modbus_rx_buffer[MODBUS_RX_BUFFER_SIZE];
-static uint8_t modbus_rx_temp_buffer[MODBUS_RX_BUFFER_SIZE];
-static OsSemaphore modbus_rx_semaphore;
+static lgc_modbus_segment_t segments[LGC_MODBUS_SEGMENT_COUNT] = {
+	{.huart = &huart3, .de_port = DIR_SENSORES_GPIO_Port, .de_pin = DIR_SENSORES_Pin, .name = "modbus"},
+#if (LGC_MODBUS_SEGMENT_COUNT > 1)
+	{.huart = &LGC_MODBUS_SEGMENT1_UART, .de_port = LGC_MODBUS_SEGMENT1_DE_PORT, .de_pin = LGC_MODBUS_SEGMENT1_DE_PIN, .name = "modbus 1"},
+#endif
+};
+static uint8_t sensor_segment[LGC_MODBUS_SENSOR_MAX] = {0}; /* segment of sensor i + 1 */
+static OsMutex xfer_mutex;									/* completion of transactions split over segments */
+static const uint32_t baud_rates[LGC_MODBUS_BAUD_MAX] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+static lgc_modbus_sensor_stats_t sensor_stats[LGC_MODBUS_SENSOR_MAX];
+static lgc_modbus_segment_stats_t segment_stats[LGC_MODBUS_SEGMENT_COUNT];
+static OsMutex stats_mutex;
+static const char *TAG = "MODBUS";
 
 /* ============================================================================
  * PRIVATE FUNCTION PROTOTYPES
@@ -51,6 +186,32 @@ static int32_t lgc_modbus_uart_read(uint8_t *buffer, uint16_t count, int32_t tim
 static int32_t lgc_modbus_uart_write(const uint8_t *buffer, uint16_t count, int32_t timeout, void *args);
 static void lgc_modbus_rx_callback(UART_HandleTypeDef *huart, uint16_t Pos);
 static void lgc_modbus_uart_error_callback(UART_HandleTypeDef *huart);
+static HAL_StatusTypeDef lgc_modbus_rx_start(lgc_modbus_segment_t *seg);
+static uint8_t lgc_modbus_rx_next(lgc_modbus_segment_t *seg, lgc_modbus_span_t *span, int32_t timeout);
+static void lgc_modbus_rx_copy(lgc_modbus_segment_t *seg, uint8_t *dest, uint16_t start, uint16_t len);
+static void lgc_modbus_rx_flush(lgc_modbus_segment_t *seg);
+static void lgc_modbus_task_entry(void *param);
+static lgc_modbus_segment_t *lgc_modbus_segment_find(UART_HandleTypeDef *huart);
+static uint16_t lgc_modbus_segment_mask(lgc_modbus_segment_t *seg, uint8_t count);
+static void lgc_modbus_xfer_complete(lgc_modbus_xfer_t *xfer, error_t err, uint16_t missing);
+static error_t lgc_modbus_xfer_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer);
+static error_t lgc_modbus_snapshot_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer);
+static uint8_t lgc_modbus_snapshot_reply(const uint8_t *reply, uint8_t seq, uint16_t *values, size_t count);
+static uint8_t lgc_modbus_fast_reply(const uint8_t *reply, uint8_t seq, uint16_t *values, size_t count);
+static error_t lgc_modbus_history_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer);
+static error_t lgc_modbus_changes_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer);
+static error_t lgc_modbus_transact(lgc_modbus_xfer_t *xfer);
+static error_t lgc_modbus_baud_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer);
+static error_t lgc_modbus_baud_apply(lgc_modbus_segment_t *seg, uint8_t code);
+static void lgc_modbus_set_timeouts(lgc_modbus_segment_t *seg, uint32_t turnaround_ms);
+static uint32_t lgc_modbus_t35_us(lgc_modbus_segment_t *seg);
+static void lgc_modbus_t35_wait(lgc_modbus_segment_t *seg);
+static uint32_t lgc_modbus_cycles_us(uint32_t cycles);
+static void lgc_modbus_stats_time(lgc_modbus_time_stats_t *time, uint32_t us);
+static void lgc_modbus_stats_reply(uint8_t dev, uint32_t cycles);
+static void lgc_modbus_stats_result(lgc_modbus_segment_t *seg, uint8_t dev, nmbs_error err);
+static void lgc_modbus_stats_round(lgc_modbus_segment_t *seg, uint16_t missing, uint32_t noise);
+static void lgc_modbus_stats_scan(lgc_modbus_segment_t *seg, uint32_t start, systime_t time);
 
 /* ============================================================================
  * PUBLIC FUNCTION DEFINITIONS
@@ -63,48 +224,199 @@ static void lgc_modbus_uart_error_callback(UART_HandleTypeDef *huart);
 error_t lgc_interface_modbus_init(void)
 {
 	error_t err = NO_ERROR;
+	OsTaskParameters params = OS_TASK_DEFAULT_PARAMS;
+	lgc_modbus_segment_t *seg;
+
+	/* cycle counter for the inter-frame gap */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	if (osCreateMutex(&xfer_mutex) != TRUE || osCreateMutex(&stats_mutex) != TRUE)
+	{
+		return ERROR_OUT_OF_RESOURCES;
+	}
+
+	for (uint8_t n = 0; n < LGC_MODBUS_SEGMENT_COUNT; n++)
+	{
+		seg = &segments[n];
+		seg->index = n;
+		seg->baud_code = LGC_MODBUS_BAUD_9600;
+
+		nmbs_platform_conf_create(&seg->platform_conf);
+		seg->platform_conf.transport = NMBS_TRANSPORT_RTU;
+		seg->platform_conf.read = lgc_modbus_uart_read;
+		seg->platform_conf.write = lgc_modbus_uart_write;
+		seg->platform_conf.arg = seg;
+		seg->platform_conf.crc_calc = checksum_nmbs_crc16;
+
+		err = nmbs_client_create(&seg->nmbs, &seg->platform_conf);
+
+		nmbs_set_destination_rtu_address(&seg->nmbs, 1); // Set Modbus slave address
+
+		// set timeout
+		lgc_modbus_set_timeouts(seg, LGC_MODBUS_TURNAROUND_MS);
+
+		/* init modbus rx semaphore */
+		if (osCreateSemaphore(&seg->rx_semaphore, 0) != TRUE)
+		{
+			return ERROR_FAILURE;
+		}
+
+		/* init transaction queue */
+		if (osCreateQueue(&seg->xfer_queue, seg->name, sizeof(lgc_modbus_xfer_t *), LGC_MODBUS_XFER_QUEUE_SIZE) != TRUE)
+		{
+			return ERROR_OUT_OF_RESOURCES;
+		}
+
+		/* register callbacks */
+		HAL_UART_RegisterRxEventCallback(seg->huart, lgc_modbus_rx_callback);
+		HAL_UART_RegisterCallback(seg->huart, HAL_UART_ERROR_CB_ID, lgc_modbus_uart_error_callback);
+
+		HAL_GPIO_WritePin(seg->de_port, seg->de_pin, GPIO_PIN_RESET);
+
+		// start reception
+		if (lgc_modbus_rx_start(seg) != HAL_OK)
+		{
+			return ERROR_FAILURE;
+		}
+
+		/* bus owner task, one per segment so the segments run concurrently */
+		params.priority = LGC_MODBUS_TASK_PRI;
+		params.stackSize = LGC_MODBUS_TASK_STACK;
+		seg->task = osCreateTask(seg->name, lgc_modbus_task_entry, seg, &params);
+
+		if (seg->task == NULL)
+		{
+			return ERROR_FAILURE;
+		}
+	}
+
+	return err;
+}
+
+/**
+ * @brief Prepare a transaction object for asynchronous use
+ * @param xfer Transaction to initialize (creates its completion event)
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_xfer_init(lgc_modbus_xfer_t *xfer)
+{
+	if (xfer == NULL)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	memset(xfer, 0, sizeof(lgc_modbus_xfer_t));
 
-	nmbs_platform_conf_create(&platform_conf);
-	platform_conf.transport = NMBS_TRANSPORT_RTU;
-	platform_conf.read = lgc_modbus_uart_read;
-	platform_conf.write = lgc_modbus_uart_write;
-	platform_conf.arg = NULL;
+	if (osCreateEvent(&xfer->event) != TRUE)
+	{
+		return ERROR_OUT_OF_RESOURCES;
+	}
 
-	err = nmbs_client_create(&nmbs, &platform_conf);
+	return NO_ERROR;
+}
 
-	nmbs_set_destination_rtu_address(&nmbs, 1); // Set Modbus slave address
+/**
+ * @brief Release the resources of a transaction object
+ * @param xfer Transaction, must not be in flight
+ */
+void lgc_modbus_xfer_deinit(lgc_modbus_xfer_t *xfer)
+{
+	osDeleteEvent(&xfer->event);
+}
 
-	// set timeout
-	nmbs_set_byte_timeout(&nmbs, NMBS_WRITE_TIMEOUT);
-	nmbs_set_read_timeout(&nmbs, NMBS_READ_TIMEOUT);
+/**
+ * @brief Queue a transaction for the bus, returns immediately
+ *
+ * Transactions to one sensor go to the segment the sensor is mapped to;
+ * broadcasts (snapshot, latch, sync, baud) run on every segment at the same
+ * time and complete once the last segment is done.
+ *
+ * The caller keeps ownership of the transaction and its data buffer until
+ * completion is reported through the callback or lgc_modbus_wait().
+ *
+ * @param xfer Initialized transaction with the request fields filled in
+ * @return error_t NO_ERROR if queued
+ */
+error_t lgc_modbus_submit(lgc_modbus_xfer_t *xfer)
+{
+	uint8_t first = 0;
+	uint8_t last = 0;
 
-	nmbs_set_byte_timeout(&nmbs, NMBS_READ_TIMEOUT);
+	if (xfer == NULL || xfer->data == NULL)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
 
-	/* init modbus mutex */
-	if (osCreateMutex(&mutex) != TRUE)
+	if (xfer->state == LGC_MODBUS_XFER_QUEUED || xfer->state == LGC_MODBUS_XFER_ACTIVE)
 	{
-		return ERROR_FAILURE;
+		return ERROR_WRONG_STATE;
 	}
 
-	/* init modbus rx semaphore */
-	if (osCreateSemaphore(&modbus_rx_semaphore, 0) != TRUE)
+	switch (xfer->type)
 	{
-		return ERROR_FAILURE;
+	case LGC_MODBUS_XFER_SNAPSHOT:
+	case LGC_MODBUS_XFER_LATCH:
+	case LGC_MODBUS_XFER_SYNC:
+	case LGC_MODBUS_XFER_BAUD:
+	case LGC_MODBUS_XFER_FAST:
+		last = LGC_MODBUS_SEGMENT_COUNT - 1;
+		break;
+	default:
+		if (xfer->dev == NMBS_BROADCAST_ADDRESS)
+		{
+			last = LGC_MODBUS_SEGMENT_COUNT - 1;
+		}
+		else if (xfer->dev >= 1 && xfer->dev <= LGC_MODBUS_SENSOR_MAX)
+		{
+			first = last = sensor_segment[xfer->dev - 1];
+		}
+		break;
+	}
+
+	osResetEvent(&xfer->event);
+	xfer->result = NO_ERROR;
+	xfer->missing = 0;
+	xfer->segments = last - first + 1;
+	xfer->state = LGC_MODBUS_XFER_QUEUED;
+
+	for (uint8_t n = first; n <= last; n++)
+	{
+		if (osSendToQueue(&segments[n].xfer_queue, &xfer, 0) != TRUE)
+		{
+			if (n == first)
+			{
+				xfer->state = LGC_MODBUS_XFER_IDLE;
+				return ERROR_OUT_OF_RESOURCES;
+			}
+			/* segments already queued finish the transaction, the rest failed */
+			lgc_modbus_xfer_complete(xfer, ERROR_OUT_OF_RESOURCES, lgc_modbus_segment_mask(&segments[n], LGC_MODBUS_SENSOR_MAX));
+		}
 	}
 
-	/* init modbus rx ring buffer */
-	lwrb_init(&modbus_rx_rb, modbus_rx_buffer, MODBUS_RX_BUFFER_SIZE);
+	return NO_ERROR;
+}
 
-	/* register callbacks */
-	HAL_UART_RegisterRxEventCallback(&huart3, lgc_modbus_rx_callback);
-	HAL_UART_RegisterCallback(&huart3, HAL_UART_ERROR_CB_ID, lgc_modbus_uart_error_callback);
+/**
+ * @brief Wait for a submitted transaction to complete
+ * @param xfer Submitted transaction
+ * @param timeout Maximum wait in milliseconds (INFINITE_DELAY to block)
+ * @return error_t Result of the transaction, ERROR_TIMEOUT if still in flight
+ */
+error_t lgc_modbus_wait(lgc_modbus_xfer_t *xfer, systime_t timeout)
+{
+	if (xfer->state == LGC_MODBUS_XFER_IDLE)
+	{
+		return ERROR_WRONG_STATE;
+	}
 
-	HAL_GPIO_WritePin(DIR_SENSORES_GPIO_Port, DIR_SENSORES_Pin, GPIO_PIN_RESET);
+	if (xfer->state != LGC_MODBUS_XFER_DONE && osWaitForEvent(&xfer->event, timeout) != TRUE)
+	{
+		return ERROR_TIMEOUT;
+	}
 
-	// start reception
-	err = HAL_UARTEx_ReceiveToIdle_DMA(&huart3, &modbus_rx_temp_buffer[0], MODBUS_RX_BUFFER_SIZE / 2);
-	
-	return err;
+	return xfer->result;
 }
 
 /**
@@ -117,15 +429,15 @@ error_t lgc_interface_modbus_init(void)
  */
 error_t lgc_modbus_read_holding_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len)
 {
-	osAcquireMutex(&mutex);
-
-	nmbs_set_destination_rtu_address(&nmbs, dev);
-
-	error_t err = nmbs_read_holding_registers(&nmbs, address, len, regs);
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_READ_HOLDING,
+		.dev = dev,
+		.address = address,
+		.quantity = (uint16_t)len,
+		.data = regs,
+	};
 
-	osReleaseMutex(&mutex);
-
-	return err;
+	return lgc_modbus_transact(&xfer);
 }
 
 /**
@@ -138,15 +450,36 @@ error_t lgc_modbus_read_holding_regs(uint8_t dev, uint16_t address, uint16_t *re
  */
 error_t lgc_modbus_read_coils(uint8_t dev, uint16_t address, uint8_t *coils, size_t len)
 {
-	osAcquireMutex(&mutex);
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_READ_COILS,
+		.dev = dev,
+		.address = address,
+		.quantity = (uint16_t)len,
+		.data = coils,
+	};
 
-	nmbs_set_destination_rtu_address(&nmbs, dev);
-
-	error_t err = nmbs_read_coils(&nmbs, address, len, coils);
+	return lgc_modbus_transact(&xfer);
+}
 
-	osReleaseMutex(&mutex);
+/**
+ * @brief Read input registers from Modbus device (sensor diagnostics)
+ * @param dev Device address
+ * @param address Starting address
+ * @param regs Pointer to register array
+ * @param len Number of registers to read
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_read_input_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len)
+{
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_READ_INPUT,
+		.dev = dev,
+		.address = address,
+		.quantity = (uint16_t)len,
+		.data = regs,
+	};
 
-	return err;
+	return lgc_modbus_transact(&xfer);
 }
 
 /**
@@ -159,104 +492,1539 @@ error_t lgc_modbus_read_coils(uint8_t dev, uint16_t address, uint8_t *coils, siz
  */
 error_t lgc_modbus_write_holding_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len)
 {
-	osAcquireMutex(&mutex);
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_WRITE_HOLDING,
+		.dev = dev,
+		.address = address,
+		.quantity = (uint16_t)len,
+		.data = regs,
+	};
+
+	return lgc_modbus_transact(&xfer);
+}
+
+/**
+ * @brief Latch and collect the DI value of all sensors in one bus cycle
+ *
+ * Blocking wrapper of a LGC_MODBUS_XFER_SNAPSHOT transaction.
+ *
+ * @param seq Sequence number echoed by the sensors
+ * @param values Output array, values[i] is written when sensor i+1 answers
+ * @param count Number of sensors (max 16)
+ * @param missing Output bitmask, bit i set if sensor i+1 did not answer
+ * @return error_t NO_ERROR if all sensors answered, ERROR_TIMEOUT otherwise
+ */
+error_t lgc_modbus_snapshot(uint16_t seq, uint16_t *values, size_t count, uint16_t *missing)
+{
+	error_t err;
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_SNAPSHOT,
+		.address = seq,
+		.quantity = (uint16_t)count,
+		.data = values,
+	};
+
+	if (missing == NULL)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	err = lgc_modbus_transact(&xfer);
+	*missing = xfer.missing;
+
+	return err;
+}
+
+/**
+ * @brief Broadcast a latch frame, every sensor stores its DI value as slice seq
+ * @param seq Sequence number of the slice (encoder step)
+ * @return error_t Status of operation (no reply is expected)
+ */
+error_t lgc_modbus_latch(uint16_t seq)
+{
+	uint16_t dummy;
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_LATCH,
+		.address = seq,
+		.data = &dummy,
+	};
+
+	return lgc_modbus_transact(&xfer);
+}
+
+/**
+ * @brief Turn the fast scan on or off on every sensor (broadcast FC16)
+ *
+ * Only a sensor that is powered and listening takes it; the flag lives in
+ * sensor RAM, so it has to be sent again after a sensor reboots.
+ *
+ * @param enable TRUE to answer poll tokens
+ * @return error_t Status of operation (no reply is expected)
+ */
+error_t lgc_modbus_fast_enable(uint8_t enable)
+{
+	uint16_t value = enable ? 1 : 0;
+
+	return lgc_modbus_write_holding_regs(NMBS_BROADCAST_ADDRESS, LGC_MODBUS_FAST_ENABLE_ADDR, &value, 1);
+}
+
+/**
+ * @brief Store the staged configuration of a sensor in its flash (FC16)
+ *
+ * Configuration writes take effect at once; this makes them survive a
+ * reboot without waiting for the sensor idle commit.
+ *
+ * @param dev Sensor address, NMBS_BROADCAST_ADDRESS for all of them
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_conf_commit(uint8_t dev)
+{
+	uint16_t value = 1;
+
+	return lgc_modbus_write_holding_regs(dev, LGC_MODBUS_CONF_COMMIT_ADDR, &value, 1);
+}
+
+/**
+ * @brief Set the ADC hardware oversampling of a sensor (FC16, both registers)
+ *
+ * The sensor restarts its acquisition and filter; the change is staged and
+ * stored with the next commit.
+ *
+ * @param dev Sensor address, NMBS_BROADCAST_ADDRESS for all of them
+ * @param ratio 2^ratio conversions per result, 0 turns it off
+ * @param shift Right shift of the result (0..ratio)
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_oversampling_set(uint8_t dev, uint8_t ratio, uint8_t shift)
+{
+	uint16_t regs[2] = {ratio, shift};
+
+	return lgc_modbus_write_holding_regs(dev, LGC_MODBUS_CONF_OVS_RATIO_ADDR, regs, 2);
+}
 
-	nmbs_set_destination_rtu_address(&nmbs, dev);
+/**
+ * @brief Latch and collect the DI value of all sensors with a fast scan token
+ *
+ * Same round as lgc_modbus_snapshot() with a 1 byte request and 3 byte
+ * replies; the sensors must have the fast scan enabled.
+ *
+ * @param seq Sequence number (the sensors rebuild it from the low byte)
+ * @param values Output array, values[i] is written when sensor i+1 answers
+ * @param count Number of sensors (max 16)
+ * @param missing Output bitmask, bit i set if sensor i+1 did not answer
+ * @return error_t NO_ERROR if all sensors answered, ERROR_TIMEOUT otherwise
+ */
+error_t lgc_modbus_fast_scan(uint16_t seq, uint16_t *values, size_t count, uint16_t *missing)
+{
+	error_t err;
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_FAST,
+		.address = seq,
+		.quantity = (uint16_t)count,
+		.data = values,
+	};
 
-	error_t err = nmbs_write_multiple_registers(&nmbs, address, len, regs);
+	if (missing == NULL)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
 
-	osReleaseMutex(&mutex);
+	err = lgc_modbus_transact(&xfer);
+	*missing = xfer.missing;
 
 	return err;
 }
 
-/* ============================================================================
- * PRIVATE FUNCTION DEFINITIONS
- * ============================================================================ */
+/**
+ * @brief Broadcast a sync frame (FC06 to SYNC_ID, address 0)
+ *
+ * Every sensor latches its filtered state tagged with id at the instant the
+ * frame ends, whatever its position on the bus. The latched values are read
+ * back later with lgc_modbus_read_sync().
+ *
+ * @param id Sync id (encoder step)
+ * @return error_t Status of operation (no reply is expected)
+ */
+error_t lgc_modbus_sync(uint16_t id)
+{
+	uint16_t dummy;
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_SYNC,
+		.address = id,
+		.data = &dummy,
+	};
+
+	return lgc_modbus_transact(&xfer);
+}
 
 /**
- * @brief UART read function for Modbus
- * @param buffer Pointer to read buffer
- * @param count Number of bytes to read
- * @param timeout Read timeout in milliseconds
- * @param args Additional arguments
- * @return int32_t Number of bytes read
+ * @brief Read the DI value latched by a sensor on sync id
+ * @param dev Device address
+ * @param id Sync id the value must belong to
+ * @param value Output DI value
+ * @return error_t ERROR_INVALID_SEQUENCE_NUMBER if the sensor missed the sync
  */
-static int32_t lgc_modbus_uart_read(uint8_t *buffer, uint16_t count, int32_t timeout, void *args)
+error_t lgc_modbus_read_sync(uint8_t dev, uint16_t id, uint16_t *value)
 {
-	/* Set direction for RS485 transceiver to RX mode */
-	HAL_GPIO_WritePin(DIR_SENSORES_GPIO_Port, DIR_SENSORES_Pin, GPIO_PIN_RESET);
+	error_t err;
+	uint16_t regs[2];
 
-	if(HAL_UART_Receive(&huart3, buffer, count, NMBS_READ_TIMEOUT) == HAL_OK)
+	if (value == NULL)
 	{
-		return count;
+		return ERROR_INVALID_PARAMETER;
 	}
 
-	if (lwrb_get_full(&modbus_rx_rb) >= count)
+	err = lgc_modbus_read_holding_regs(dev, LGC_MODBUS_SYNC_ID_ADDR, regs, 2);
+	if (err != NO_ERROR)
 	{
-		lwrb_read(&modbus_rx_rb, buffer, count);
-		return (int32_t)count;
+		return err;
 	}
-	else if (osWaitForSemaphore(&modbus_rx_semaphore, NMBS_READ_TIMEOUT) == TRUE)
+
+	if (regs[0] != id)
 	{
-		if (lwrb_get_full(&modbus_rx_rb) >= count)
-		{
-			lwrb_read(&modbus_rx_rb, buffer, count);
-			return (int32_t)count;
-		}
+		return ERROR_INVALID_SEQUENCE_NUMBER;
 	}
+	*value = regs[1];
 
-	return 0;
+	return NO_ERROR;
 }
 
 /**
- * @brief UART write function for Modbus
- * @param buffer Pointer to write buffer
- * @param count Number of bytes to write
- * @param timeout Write timeout in milliseconds
- * @param args Additional arguments
- * @return int32_t Number of bytes written
+ * @brief Switch the local UART to a baud rate code, sensors are not told
+ * @param code Rate code (lgc_modbus_baud_t)
+ * @return error_t Status of operation
  */
-static int32_t lgc_modbus_uart_write(const uint8_t *buffer, uint16_t count, int32_t timeout, void *args)
+error_t lgc_modbus_baud_set(uint8_t code)
 {
-	/* Set direction for RS485 transceiver to TX mode */
-	HAL_GPIO_WritePin(DIR_SENSORES_GPIO_Port, DIR_SENSORES_Pin, GPIO_PIN_SET);
+	uint16_t dummy;
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_BAUD,
+		.address = code,
+		.quantity = 0,
+		.data = &dummy,
+	};
+
+	return lgc_modbus_transact(&xfer);
+}
+
+/**
+ * @brief Move the whole sensor bus to a new baud rate
+ *
+ * Broadcasts the switch, moves the local UART at the same point and checks
+ * sensors 1..count at the new rate. If all of them answer the rate is
+ * committed (stored) on every sensor; otherwise the controller goes back to
+ * the previous rate and waits for the sensors to revert on their own.
+ *
+ * @param code Rate code (lgc_modbus_baud_t)
+ * @param count Number of sensors (max 16)
+ * @param missing Output bitmask, bit i set if sensor i+1 failed
+ * @return error_t NO_ERROR if the bus runs at the new rate
+ */
+error_t lgc_modbus_baud_negotiate(uint8_t code, uint8_t count, uint16_t *missing)
+{
+	error_t err;
+	uint16_t dummy;
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_BAUD,
+		.address = code,
+		.quantity = count,
+		.data = &dummy,
+	};
 
-	if (HAL_UART_Transmit(&huart3, (uint8_t *)buffer, count, timeout) == HAL_OK)
+	if (missing == NULL || count == 0)
 	{
-		/* Set direction back to RX mode */
-		HAL_GPIO_WritePin(DIR_SENSORES_GPIO_Port, DIR_SENSORES_Pin, GPIO_PIN_RESET);
-		return (int32_t)count;
+		return ERROR_INVALID_PARAMETER;
 	}
 
-	/* Set direction back to RX mode on error */
-	HAL_GPIO_WritePin(DIR_SENSORES_GPIO_Port, DIR_SENSORES_Pin, GPIO_PIN_RESET);
+	err = lgc_modbus_transact(&xfer);
+	*missing = xfer.missing;
 
-	return 0;
+	return err;
 }
 
 /**
- * @brief UART error callback
- * @param huart UART handle
+ * @brief Current sensor bus baud rate code
+ * @return uint8_t Rate code (lgc_modbus_baud_t)
  */
-static void lgc_modbus_uart_error_callback(UART_HandleTypeDef *huart)
+uint8_t lgc_modbus_baud_get(void)
 {
-	HAL_UARTEx_ReceiveToIdle_DMA(&huart3, &modbus_rx_temp_buffer[0], MODBUS_RX_BUFFER_SIZE / 2);
+	return segments[0].baud_code;
 }
 
 /**
- * @brief UART RX complete callback
- * @param huart UART handle
- * @param Pos Current position in DMA buffer
+ * @brief Move a sensor to another RS-485 segment
+ *
+ * Only routes the transactions; call lgc_modbus_chain_setup() once the map
+ * is complete so the sensors reorder their snapshot replies.
+ *
+ * @param dev Device address (1..LGC_MODBUS_SENSOR_MAX)
+ * @param segment Segment index (0..LGC_MODBUS_SEGMENT_COUNT - 1)
+ * @return error_t Status of operation
  */
-static void lgc_modbus_rx_callback(UART_HandleTypeDef *huart, uint16_t Pos)
+error_t lgc_modbus_segment_set(uint8_t dev, uint8_t segment)
+{
+	if (dev == 0 || dev > LGC_MODBUS_SENSOR_MAX || segment >= LGC_MODBUS_SEGMENT_COUNT)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	sensor_segment[dev - 1] = segment;
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief Segment a sensor is mapped to
+ * @param dev Device address (1..LGC_MODBUS_SENSOR_MAX)
+ * @return uint8_t Segment index
+ */
+uint8_t lgc_modbus_segment_get(uint8_t dev)
+{
+	if (dev == 0 || dev > LGC_MODBUS_SENSOR_MAX)
+	{
+		return 0;
+	}
+
+	return sensor_segment[dev - 1];
+}
+
+/**
+ * @brief Write the snapshot chain of sensors 1..count from the segment map
+ *
+ * Each sensor learns the address answering before it on its own segment
+ * and its position there, so every segment runs a short chain of its own.
+ *
+ * @param count Number of sensors (max LGC_MODBUS_SENSOR_MAX)
+ * @param missing Output bitmask, bit i set if sensor i+1 did not take its chain
+ * @return error_t NO_ERROR if every sensor was updated
+ */
+error_t lgc_modbus_chain_setup(uint8_t count, uint16_t *missing)
 {
-	/* Write data to ring buffer */
-	lwrb_write(&modbus_rx_rb, &modbus_rx_temp_buffer[0], Pos);
+	uint16_t regs[2];
+	uint8_t prev[LGC_MODBUS_SEGMENT_COUNT] = {0};
+	uint8_t slot[LGC_MODBUS_SEGMENT_COUNT] = {0};
+	uint8_t n;
 
-	/* Restart reception */
-	HAL_UARTEx_ReceiveToIdle_DMA(&huart3, &modbus_rx_temp_buffer[0], MODBUS_RX_BUFFER_SIZE / 2);
+	if (missing == NULL || count > LGC_MODBUS_SENSOR_MAX)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
 
-	/* Release semaphore to signal data availability */
-	osReleaseSemaphore(&modbus_rx_semaphore);
+	*missing = 0;
+	for (uint8_t i = 0; i < count; i++)
+	{
+		n = sensor_segment[i];
+		regs[0] = prev[n];
+		regs[1] = slot[n];
+		if (lgc_modbus_write_holding_regs(i + 1, LGC_MODBUS_CHAIN_PREV_ADDR, regs, 2) != NO_ERROR)
+		{
+			*missing |= (1U << i);
+		}
+		prev[n] = i + 1;
+		slot[n]++;
+	}
+
+	return (*missing == 0) ? NO_ERROR : ERROR_FAILURE;
+}
+
+/**
+ * @brief Read the slices newer than since from a sensor history ring
+ *
+ * One FC23 transaction: writes HIST_SINCE and reads the history block.
+ * Slices are returned oldest first; a gap between since and the first
+ * slice means the ring overflowed.
+ *
+ * @param dev Device address
+ * @param since Last slice already collected
+ * @param slices Output array
+ * @param max Size of the output array (max LGC_MODBUS_HIST_SLICES_MAX)
+ * @param count Number of slices written
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_read_history(uint8_t dev, uint16_t since, lgc_modbus_slice_t *slices, size_t max, uint16_t *count)
+{
+	error_t err;
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_HISTORY,
+		.dev = dev,
+		.address = since,
+		.quantity = (uint16_t)max,
+		.data = slices,
+	};
+
+	if (count == NULL)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	err = lgc_modbus_transact(&xfer);
+	*count = xfer.count;
+
+	return err;
+}
+
+/**
+ * @brief Read the changes newer than since from a sensor change log
+ *
+ * One FC23 transaction: writes CHG_SINCE and reads the change log block.
+ * The sensor only logs a DI value when it differs from the previous latch,
+ * so a sensor that saw nothing new answers with the header alone. The reply
+ * is sized for max entries; with more pending, the sensor cuts head short
+ * and sets the more flag.
+ *
+ * @param dev Device address
+ * @param since Last sequence already rebuilt
+ * @param changes Output reply
+ * @param max Entries to ask for (1..LGC_MODBUS_CHG_ENTRIES_MAX)
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_read_changes(uint8_t dev, uint16_t since, lgc_modbus_changes_t *changes, size_t max)
+{
+	lgc_modbus_xfer_t xfer = {
+		.type = LGC_MODBUS_XFER_CHANGES,
+		.dev = dev,
+		.address = since,
+		.quantity = (uint16_t)max,
+		.data = changes,
+	};
+
+	return lgc_modbus_transact(&xfer);
+}
+
+/**
+ * @brief Copy the bus statistics of one sensor
+ * @param dev Device address (1..LGC_MODBUS_SENSOR_MAX)
+ * @param stats Output statistics
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_stats_sensor(uint8_t dev, lgc_modbus_sensor_stats_t *stats)
+{
+	if (dev == 0 || dev > LGC_MODBUS_SENSOR_MAX || stats == NULL)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	osAcquireMutex(&stats_mutex);
+	*stats = sensor_stats[dev - 1];
+	osReleaseMutex(&stats_mutex);
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief Copy the bus statistics of one segment
+ * @param segment Segment index (0..LGC_MODBUS_SEGMENT_COUNT - 1)
+ * @param stats Output statistics
+ * @return error_t Status of operation
+ */
+error_t lgc_modbus_stats_segment(uint8_t segment, lgc_modbus_segment_stats_t *stats)
+{
+	if (segment >= LGC_MODBUS_SEGMENT_COUNT || stats == NULL)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	osAcquireMutex(&stats_mutex);
+	*stats = segment_stats[segment];
+	osReleaseMutex(&stats_mutex);
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief Average of a time statistic
+ * @param time Time statistic
+ * @return uint32_t Average in microseconds, 0 without samples
+ */
+uint32_t lgc_modbus_stats_avg(const lgc_modbus_time_stats_t *time)
+{
+	return (time->count == 0) ? 0 : (uint32_t)(time->sum / time->count);
+}
+
+/**
+ * @brief Clear the statistics of every sensor and segment
+ */
+void lgc_modbus_stats_reset(void)
+{
+	osAcquireMutex(&stats_mutex);
+	memset(sensor_stats, 0, sizeof(sensor_stats));
+	memset(segment_stats, 0, sizeof(segment_stats));
+	osReleaseMutex(&stats_mutex);
+}
+
+/**
+ * @brief Print the statistics of every segment and of sensors 1..count to the log
+ *
+ * Times are min/avg/max in microseconds; the histogram bins start below
+ * LGC_MODBUS_STATS_BIN0_US and double from there. Needs STM32_LOG_LEVEL at
+ * INFO or above, otherwise it compiles to nothing: the HMI diagnostics page
+ * shows the same counters at any log level.
+ *
+ * @param count Number of sensors (max LGC_MODBUS_SENSOR_MAX)
+ */
+void lgc_modbus_stats_dump(uint8_t count)
+{
+	lgc_modbus_segment_stats_t segment;
+	lgc_modbus_sensor_stats_t sensor;
+
+	for (uint8_t n = 0; n < LGC_MODBUS_SEGMENT_COUNT; n++)
+	{
+		lgc_modbus_stats_segment(n, &segment);
+		STM32_LOGI(TAG, "seg %u: scan %lu/%lu/%lu us (%lu), period %lu/%lu/%lu us, noise %lu", n,
+				   segment.scan.min, lgc_modbus_stats_avg(&segment.scan), segment.scan.max, segment.scan.count,
+				   segment.period.min, lgc_modbus_stats_avg(&segment.period), segment.period.max, segment.noise);
+	}
+
+	for (uint8_t dev = 1; dev <= count && dev <= LGC_MODBUS_SENSOR_MAX; dev++)
+	{
+		lgc_modbus_stats_sensor(dev, &sensor);
+		STM32_LOGI(TAG, "dev %u (seg %u): rtt %lu/%lu/%lu us (%lu), timeout %lu, crc %lu, exception %lu", dev,
+				   sensor_segment[dev - 1], sensor.rtt.min, lgc_modbus_stats_avg(&sensor.rtt), sensor.rtt.max,
+				   sensor.rtt.count, sensor.timeouts, sensor.crc_errors, sensor.exceptions);
+		STM32_LOGI(TAG, "dev %u: hist %lu %lu %lu %lu %lu %lu %lu %lu", dev, sensor.hist[0], sensor.hist[1],
+				   sensor.hist[2], sensor.hist[3], sensor.hist[4], sensor.hist[5], sensor.hist[6], sensor.hist[7]);
+	}
+}
+
+/* ============================================================================
+ * PRIVATE FUNCTION DEFINITIONS
+ * ============================================================================ */
+
+/**
+ * @brief Modbus task, sole owner of one sensor bus segment
+ *
+ * Transaction states: QUEUED -> ACTIVE -> DONE. The task sleeps on the
+ * queue while idle and on the rx semaphore (posted by the DMA idle-line
+ * callback) while a transaction is on the wire. Broadcasts run on every
+ * segment at once and complete when the last one is done.
+ *
+ * @param param Segment served by this task
+ */
+static void lgc_modbus_task_entry(void *param)
+{
+	lgc_modbus_segment_t *seg = (lgc_modbus_segment_t *)param;
+	lgc_modbus_xfer_t *xfer;
+	error_t err;
+	uint32_t start;
+	systime_t time;
+
+	for (;;)
+	{
+		if (osReceiveFromQueue(&seg->xfer_queue, &xfer, INFINITE_DELAY) != TRUE)
+		{
+			continue;
+		}
+
+		xfer->state = LGC_MODBUS_XFER_ACTIVE;
+		seg->missing = 0;
+		start = DWT->CYCCNT;
+		time = osGetSystemTime();
+		err = lgc_modbus_xfer_execute(seg, xfer);
+		if (xfer->type == LGC_MODBUS_XFER_SNAPSHOT || xfer->type == LGC_MODBUS_XFER_LATCH ||
+			xfer->type == LGC_MODBUS_XFER_FAST)
+		{
+			lgc_modbus_stats_scan(seg, start, time);
+		}
+		lgc_modbus_xfer_complete(xfer, err, seg->missing);
+	}
+}
+
+/**
+ * @brief Find the segment of a UART handle
+ * @param huart UART handle
+ * @return lgc_modbus_segment_t* Segment, NULL if the UART is not a sensor bus
+ */
+static lgc_modbus_segment_t *lgc_modbus_segment_find(UART_HandleTypeDef *huart)
+{
+	for (uint8_t n = 0; n < LGC_MODBUS_SEGMENT_COUNT; n++)
+	{
+		if (segments[n].huart == huart)
+		{
+			return &segments[n];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Sensors among 1..count mapped to a segment
+ * @param seg Segment
+ * @param count Number of sensors (max LGC_MODBUS_SENSOR_MAX)
+ * @return uint16_t Bit i set if sensor i+1 is on the segment
+ */
+static uint16_t lgc_modbus_segment_mask(lgc_modbus_segment_t *seg, uint8_t count)
+{
+	uint16_t mask = 0;
+
+	for (uint8_t i = 0; i < count && i < LGC_MODBUS_SENSOR_MAX; i++)
+	{
+		if (sensor_segment[i] == seg->index)
+		{
+			mask |= (1U << i);
+		}
+	}
+
+	return mask;
+}
+
+/**
+ * @brief Merge the result of one segment, complete the transaction after the last one
+ * @param xfer Transaction
+ * @param err Result on this segment
+ * @param missing Sensors of this segment that did not answer
+ */
+static void lgc_modbus_xfer_complete(lgc_modbus_xfer_t *xfer, error_t err, uint16_t missing)
+{
+	uint8_t done;
+
+	osAcquireMutex(&xfer_mutex);
+	xfer->missing |= missing;
+	if (err != NO_ERROR && xfer->result == NO_ERROR)
+	{
+		xfer->result = err;
+	}
+	done = (--xfer->segments == 0);
+	if (done)
+	{
+		xfer->state = LGC_MODBUS_XFER_DONE;
+	}
+	osReleaseMutex(&xfer_mutex);
+
+	if (!done)
+	{
+		return;
+	}
+
+	/* wake a waiter first: a resubmit from the callback resets the event and
+	 * must not be signalled by this completion */
+	osSetEvent(&xfer->event);
+	/* notify the owner, the callback may resubmit the same transaction */
+	if (xfer->callback != NULL)
+	{
+		xfer->callback(xfer);
+	}
+}
+
+/**
+ * @brief Run one transaction on the bus
+ * @param seg Segment
+ * @param xfer Active transaction
+ * @return error_t Result of the transaction
+ */
+static error_t lgc_modbus_xfer_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer)
+{
+	error_t err;
+
+	/* every transaction starts on a clean line */
+	lgc_modbus_rx_flush(seg);
+
+	/* sensors write their flash before answering a write */
+	lgc_modbus_set_timeouts(seg, (xfer->type == LGC_MODBUS_XFER_WRITE_HOLDING) ? LGC_MODBUS_WRITE_TURNAROUND_MS
+																		   : LGC_MODBUS_TURNAROUND_MS);
+
+	switch (xfer->type)
+	{
+	case LGC_MODBUS_XFER_READ_HOLDING:
+		nmbs_set_destination_rtu_address(&seg->nmbs, xfer->dev);
+		err = nmbs_read_holding_registers(&seg->nmbs, xfer->address, xfer->quantity, (uint16_t *)xfer->data);
+		lgc_modbus_stats_result(seg, xfer->dev, err);
+		break;
+	case LGC_MODBUS_XFER_READ_INPUT:
+		nmbs_set_destination_rtu_address(&seg->nmbs, xfer->dev);
+		err = nmbs_read_input_registers(&seg->nmbs, xfer->address, xfer->quantity, (uint16_t *)xfer->data);
+		lgc_modbus_stats_result(seg, xfer->dev, err);
+		break;
+	case LGC_MODBUS_XFER_READ_COILS:
+		nmbs_set_destination_rtu_address(&seg->nmbs, xfer->dev);
+		err = nmbs_read_coils(&seg->nmbs, xfer->address, xfer->quantity, (uint8_t *)xfer->data);
+		lgc_modbus_stats_result(seg, xfer->dev, err);
+		break;
+	case LGC_MODBUS_XFER_WRITE_HOLDING:
+		nmbs_set_destination_rtu_address(&seg->nmbs, xfer->dev);
+		err = nmbs_write_multiple_registers(&seg->nmbs, xfer->address, xfer->quantity, (const uint16_t *)xfer->data);
+		lgc_modbus_stats_result(seg, xfer->dev, err);
+		break;
+	case LGC_MODBUS_XFER_SNAPSHOT:
+	case LGC_MODBUS_XFER_LATCH:
+	case LGC_MODBUS_XFER_FAST:
+		err = lgc_modbus_snapshot_execute(seg, xfer);
+		break;
+	case LGC_MODBUS_XFER_HISTORY:
+		err = lgc_modbus_history_execute(seg, xfer);
+		break;
+	case LGC_MODBUS_XFER_CHANGES:
+		err = lgc_modbus_changes_execute(seg, xfer);
+		break;
+	case LGC_MODBUS_XFER_SYNC:
+		/* broadcast: nanoMODBUS does not wait for a reply */
+		nmbs_set_destination_rtu_address(&seg->nmbs, NMBS_BROADCAST_ADDRESS);
+		err = nmbs_write_single_register(&seg->nmbs, LGC_MODBUS_SYNC_ID_ADDR, xfer->address);
+		break;
+	case LGC_MODBUS_XFER_BAUD:
+		err = lgc_modbus_baud_execute(seg, xfer);
+		break;
+	default:
+		err = ERROR_INVALID_PARAMETER;
+		break;
+	}
+
+	return err;
+}
+
+/**
+ * @brief Submit a transaction and block until it completes
+ * @param xfer Transaction on the caller stack
+ * @return error_t Result of the transaction
+ */
+static error_t lgc_modbus_transact(lgc_modbus_xfer_t *xfer)
+{
+	error_t err;
+
+	if (osCreateEvent(&xfer->event) != TRUE)
+	{
+		return ERROR_OUT_OF_RESOURCES;
+	}
+
+	err = lgc_modbus_submit(xfer);
+	if (err == NO_ERROR)
+	{
+		/* always block on the event: the task signals it last */
+		osWaitForEvent(&xfer->event, INFINITE_DELAY);
+		err = xfer->result;
+	}
+
+	osDeleteEvent(&xfer->event);
+
+	return err;
+}
+
+/**
+ * @brief Broadcast a snapshot/latch frame or a fast scan token and collect the chained replies
+ *
+ * Every sensor latches its DI value and, for a snapshot or a token, the
+ * sensors of this segment answer one after another along their chain
+ * (address order unless lgc_modbus_chain_setup() reordered it).
+ *
+ * @param seg Segment running the transaction
+ * @param xfer Snapshot, latch or fast transaction (address = sequence, data = values)
+ * @return error_t NO_ERROR if all sensors answered, ERROR_TIMEOUT otherwise
+ */
+static error_t lgc_modbus_snapshot_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer)
+{
+	uint8_t frame[4 * LGC_MODBUS_SNAPSHOT_RSP_LEN];
+	uint8_t *reply;
+	lgc_modbus_span_t span;
+	uint16_t len;
+	uint16_t *values = (uint16_t *)xfer->data;
+	uint16_t seq = xfer->address;
+	size_t count = xfer->quantity;
+	uint16_t pending;
+	uint16_t crc;
+	systime_t start;
+	systime_t elapsed;
+	systime_t timeout;
+	uint32_t slot_us;
+	uint8_t slots = 0;
+	uint8_t fast = (xfer->type == LGC_MODBUS_XFER_FAST) ? TRUE : FALSE;
+	uint16_t req_len = fast ? LGC_MODBUS_FAST_REQ_LEN : LGC_MODBUS_SNAPSHOT_REQ_LEN;
+	uint16_t rsp_len = fast ? LGC_MODBUS_FAST_RSP_LEN : LGC_MODBUS_SNAPSHOT_RSP_LEN;
+	uint8_t addr;
+	uint8_t matched;
+	uint32_t noise = 0;
+	uint32_t prev;
+
+	if (xfer->type != LGC_MODBUS_XFER_LATCH && (count == 0 || count > 16))
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	/* only the sensors of this segment answer here */
+	pending = lgc_modbus_segment_mask(seg, (uint8_t)count);
+	seg->missing = pending;
+	for (uint16_t mask = pending; mask != 0; mask &= mask - 1)
+	{
+		slots++;
+	}
+	/* worst case: every sensor uses its full slot */
+	slot_us = ((rsp_len * 10UL * 1000000UL) / seg->huart->Init.BaudRate) + lgc_modbus_t35_us(seg) +
+			  LGC_MODBUS_SNAPSHOT_GUARD_US;
+	timeout = (systime_t)((slot_us * slots + 999) / 1000) + LGC_MODBUS_SNAPSHOT_MARGIN_MS;
+
+	if (fast)
+	{
+		/* the token is the low byte of the sequence, nothing else */
+		frame[0] = (uint8_t)seq;
+	}
+	else
+	{
+		frame[0] = NMBS_BROADCAST_ADDRESS;
+		frame[1] = (xfer->type == LGC_MODBUS_XFER_LATCH) ? LGC_MODBUS_FC_LATCH : LGC_MODBUS_FC_SNAPSHOT;
+		frame[2] = (uint8_t)(seq >> 8);
+		frame[3] = (uint8_t)seq;
+		crc = checksum_nmbs_crc16(frame, LGC_MODBUS_SNAPSHOT_REQ_LEN - 2, NULL);
+		frame[4] = (uint8_t)(crc >> 8);
+		frame[5] = (uint8_t)crc;
+	}
+
+	if (lgc_modbus_uart_write(frame, req_len, NMBS_WRITE_TIMEOUT, seg) != req_len)
+	{
+		return ERROR_FAILURE;
+	}
+
+	if (xfer->type == LGC_MODBUS_XFER_LATCH)
+	{
+		seg->missing = 0;
+		return NO_ERROR;
+	}
+
+	/* each reply is timed from the frame before it on the line */
+	prev = seg->tx_cycles;
+	start = osGetSystemTime();
+	while (pending != 0)
+	{
+		elapsed = osGetSystemTime() - start;
+		if (elapsed >= timeout || lgc_modbus_rx_next(seg, &span, (int32_t)(timeout - elapsed)) == FALSE)
+		{
+			break;
+		}
+
+		/* one frame per reply; scan it anyway in case two replies merged, resync on garbage */
+		len = (span.len < sizeof(frame)) ? span.len : sizeof(frame);
+		lgc_modbus_rx_copy(seg, frame, span.start, len);
+		matched = 0;
+		for (uint16_t i = 0; i + rsp_len <= len;)
+		{
+			reply = &frame[i];
+			addr = fast ? lgc_modbus_fast_reply(reply, (uint8_t)seq, values, count)
+						: lgc_modbus_snapshot_reply(reply, (uint8_t)seq, values, count);
+			if (addr != 0)
+			{
+				pending &= ~(1U << (addr - 1));
+				lgc_modbus_stats_reply(addr, span.stamp - prev);
+				matched++;
+				i += rsp_len;
+			}
+			else
+			{
+				i++;
+			}
+		}
+		if (matched == 0)
+		{
+			noise++;
+		}
+		prev = span.stamp;
+	}
+
+	seg->missing = pending;
+	lgc_modbus_stats_round(seg, pending, noise);
+
+	return (pending == 0) ? NO_ERROR : ERROR_TIMEOUT;
+}
+
+/**
+ * @brief Check a snapshot reply and store its value
+ * @param reply LGC_MODBUS_SNAPSHOT_RSP_LEN bytes
+ * @param seq Low byte of the snapshot sequence
+ * @param values Output array, values[addr - 1]
+ * @param count Number of sensors
+ * @return uint8_t Sensor address, 0 if the reply is not valid
+ */
+static uint8_t lgc_modbus_snapshot_reply(const uint8_t *reply, uint8_t seq, uint16_t *values, size_t count)
+{
+	uint16_t crc = checksum_nmbs_crc16(reply, LGC_MODBUS_SNAPSHOT_RSP_LEN - 2, NULL);
+
+	if (reply[1] != LGC_MODBUS_FC_SNAPSHOT || reply[2] != seq || reply[0] < 1 || reply[0] > count ||
+		reply[5] != (uint8_t)(crc >> 8) || reply[6] != (uint8_t)crc)
+	{
+		return 0;
+	}
+
+	values[reply[0] - 1] = ((uint16_t)reply[3] << 8) | reply[4];
+
+	return reply[0];
+}
+
+/**
+ * @brief Check a fast scan reply and store its value
+ * @param reply LGC_MODBUS_FAST_RSP_LEN bytes
+ * @param seq Token sent (low byte of the sequence)
+ * @param values Output array, values[addr - 1]
+ * @param count Number of sensors
+ * @return uint8_t Sensor address, 0 if the reply is not valid
+ */
+static uint8_t lgc_modbus_fast_reply(const uint8_t *reply, uint8_t seq, uint16_t *values, size_t count)
+{
+	uint8_t check[LGC_MODBUS_FAST_RSP_LEN] = {seq, reply[0], reply[1]};
+	uint8_t addr = reply[0] >> 2;
+
+	/* the token is part of the crc: a late reply to the previous one fails */
+	if (addr < 1 || addr > count || checksum_crc8(check, LGC_MODBUS_FAST_RSP_LEN) != reply[2])
+	{
+		return 0;
+	}
+
+	values[addr - 1] = ((uint16_t)(reply[0] & 0x03) << 8) | reply[1];
+
+	return addr;
+}
+
+/**
+ * @brief Baud rate switch: local only (quantity 0) or negotiated with the sensors
+ *
+ * Each segment negotiates with its own sensors and keeps or drops the new
+ * rate on its own.
+ *
+ * @param seg Segment running the transaction
+ * @param xfer Baud transaction (address = code, quantity = sensor count)
+ * @return error_t NO_ERROR if the bus runs at the new rate
+ */
+static error_t lgc_modbus_baud_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer)
+{
+	uint8_t code = (uint8_t)xfer->address;
+	uint8_t prev = seg->baud_code;
+	uint16_t pending;
+	uint16_t mask;
+	uint16_t regs[2];
+	uint16_t value;
+	error_t err;
+
+	if (code >= LGC_MODBUS_BAUD_MAX || xfer->quantity > 16)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	if (xfer->quantity == 0)
+	{
+		return lgc_modbus_baud_apply(seg, code);
+	}
+
+	/* every sensor switches LGC_MODBUS_BAUD_SWITCH_MS after this frame */
+	regs[0] = code;
+	regs[1] = LGC_MODBUS_BAUD_SWITCH_MS;
+	nmbs_set_destination_rtu_address(&seg->nmbs, NMBS_BROADCAST_ADDRESS);
+	err = nmbs_write_multiple_registers(&seg->nmbs, LGC_MODBUS_BAUD_CODE_ADDR, 2, regs);
+	if (err != NO_ERROR)
+	{
+		return err;
+	}
+
+	osDelayTask(LGC_MODBUS_BAUD_SWITCH_MS + LGC_MODBUS_BAUD_SETTLE_MS);
+	err = lgc_modbus_baud_apply(seg, code);
+	if (err != NO_ERROR)
+	{
+		return err;
+	}
+
+	/* verify every sensor at the new rate before committing any of them */
+	mask = lgc_modbus_segment_mask(seg, (uint8_t)xfer->quantity);
+	pending = mask;
+	for (uint8_t retry = 0; retry < LGC_MODBUS_BAUD_RETRY && pending != 0; retry++)
+	{
+		for (uint8_t i = 0; i < xfer->quantity; i++)
+		{
+			if ((pending & (1U << i)) == 0)
+			{
+				continue;
+			}
+			nmbs_set_destination_rtu_address(&seg->nmbs, i + 1);
+			if (nmbs_read_holding_registers(&seg->nmbs, LGC_MODBUS_BAUD_CODE_ADDR, 1, &value) == NMBS_ERROR_NONE && value == code)
+			{
+				pending &= ~(1U << i);
+			}
+		}
+	}
+
+	if (pending != 0)
+	{
+		/* fall back: sensors that switched revert when their trial expires */
+		seg->missing = pending;
+		lgc_modbus_baud_apply(seg, prev);
+		osDelayTask(LGC_MODBUS_BAUD_TRIAL_MS + LGC_MODBUS_BAUD_SETTLE_MS);
+		return ERROR_TIMEOUT;
+	}
+
+	/* commit: the sensors store the rate in their configuration */
+	lgc_modbus_set_timeouts(seg, LGC_MODBUS_WRITE_TURNAROUND_MS);
+	pending = mask;
+	for (uint8_t retry = 0; retry < LGC_MODBUS_BAUD_RETRY && pending != 0; retry++)
+	{
+		for (uint8_t i = 0; i < xfer->quantity; i++)
+		{
+			if ((pending & (1U << i)) == 0)
+			{
+				continue;
+			}
+			nmbs_set_destination_rtu_address(&seg->nmbs, i + 1);
+			if (nmbs_write_single_register(&seg->nmbs, LGC_MODBUS_BAUD_COMMIT_ADDR, code) == NMBS_ERROR_NONE)
+			{
+				pending &= ~(1U << i);
+			}
+		}
+	}
+	seg->missing = pending;
+
+	return (pending == 0) ? NO_ERROR : ERROR_FAILURE;
+}
+
+/**
+ * @brief Reconfigure the sensor UART for a rate code
+ * @param seg Segment
+ * @param code Rate code (lgc_modbus_baud_t)
+ * @return error_t Status of operation
+ */
+static error_t lgc_modbus_baud_apply(lgc_modbus_segment_t *seg, uint8_t code)
+{
+	uint32_t rate = baud_rates[code];
+
+	HAL_UART_AbortReceive(seg->huart);
+
+	/* APB1 is 45 MHz: oversampling by 8 keeps the error low at the top rates */
+	seg->huart->Init.BaudRate = rate;
+	seg->huart->Init.OverSampling = (rate > 230400) ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+	if (HAL_UART_Init(seg->huart) != HAL_OK)
+	{
+		return ERROR_FAILURE;
+	}
+	seg->baud_code = code;
+	lgc_modbus_set_timeouts(seg, LGC_MODBUS_TURNAROUND_MS);
+
+	/* frames received at the old rate are meaningless */
+	lgc_modbus_rx_flush(seg);
+	if (lgc_modbus_rx_start(seg) != HAL_OK)
+	{
+		return ERROR_FAILURE;
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief Recompute the nanoMODBUS timeouts from the current baud rate
+ *
+ * Frames reach nanoMODBUS only once complete (idle line), so the read
+ * timeout covers the sensor turnaround plus the longest RTU frame, and the
+ * byte timeout only has to bridge a gap inside a frame (t3.5).
+ *
+ * @param seg Segment
+ * @param turnaround_ms Time the sensor may take before answering
+ */
+static void lgc_modbus_set_timeouts(lgc_modbus_segment_t *seg, uint32_t turnaround_ms)
+{
+	uint32_t rate = seg->huart->Init.BaudRate;
+	uint32_t t35_us = lgc_modbus_t35_us(seg);
+	uint32_t frame_ms = (256UL * 10UL * 1000UL + rate - 1) / rate;
+
+	seg->t35_cycles = (SystemCoreClock / 1000000UL) * t35_us;
+	seg->char_cycles = (SystemCoreClock / rate) * 10UL;
+
+	nmbs_set_byte_timeout(&seg->nmbs, (int32_t)((t35_us + 999) / 1000 + 1));
+	nmbs_set_read_timeout(&seg->nmbs, (int32_t)(turnaround_ms + frame_ms + 1));
+}
+
+/**
+ * @brief RTU inter-frame gap (t3.5) at the current rate
+ * @param seg Segment
+ * @return uint32_t t3.5 in microseconds, fixed 1750 us above 19200 baud
+ */
+static uint32_t lgc_modbus_t35_us(lgc_modbus_segment_t *seg)
+{
+	uint32_t rate = seg->huart->Init.BaudRate;
+
+	return (rate > 19200) ? 1750 : (35000000UL / rate);
+}
+
+/**
+ * @brief Hold the bus until t3.5 has elapsed since the last activity
+ *
+ * The idle-line event and the end of our own transmission stamp the line
+ * with the DWT cycle counter, so the next request leaves exactly one gap
+ * after the previous frame instead of a millisecond tick later.
+ * @param seg Segment
+ */
+static void lgc_modbus_t35_wait(lgc_modbus_segment_t *seg)
+{
+	uint32_t elapsed;
+
+	while ((elapsed = DWT->CYCCNT - seg->line_cycles) < seg->t35_cycles)
+	{
+		/* sleep through long gaps (low rates), spin the last stretch */
+		if (seg->t35_cycles - elapsed > 2UL * (SystemCoreClock / 1000UL))
+		{
+			osDelayTask(1);
+		}
+	}
+}
+
+/**
+ * @brief Convert DWT cycles to microseconds
+ * @param cycles Core cycles
+ * @return uint32_t Microseconds
+ */
+static uint32_t lgc_modbus_cycles_us(uint32_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000UL);
+}
+
+/**
+ * @brief Add a sample to a time statistic, stats_mutex held
+ * @param time Time statistic
+ * @param us Sample in microseconds
+ */
+static void lgc_modbus_stats_time(lgc_modbus_time_stats_t *time, uint32_t us)
+{
+	if (time->count == 0 || us < time->min)
+	{
+		time->min = us;
+	}
+	if (us > time->max)
+	{
+		time->max = us;
+	}
+	time->sum += us;
+	time->count++;
+}
+
+/**
+ * @brief Account a valid reply of a sensor
+ * @param dev Device address (1..LGC_MODBUS_SENSOR_MAX)
+ * @param cycles Reply time in core cycles
+ */
+static void lgc_modbus_stats_reply(uint8_t dev, uint32_t cycles)
+{
+	lgc_modbus_sensor_stats_t *stats = &sensor_stats[dev - 1];
+	uint32_t us = lgc_modbus_cycles_us(cycles);
+	uint32_t edge = LGC_MODBUS_STATS_BIN0_US;
+	uint8_t bin = 0;
+
+	while (bin < LGC_MODBUS_STATS_BINS - 1 && us >= edge)
+	{
+		bin++;
+		edge <<= 1;
+	}
+
+	osAcquireMutex(&stats_mutex);
+	lgc_modbus_stats_time(&stats->rtt, us);
+	stats->hist[bin]++;
+	osReleaseMutex(&stats_mutex);
+}
+
+/**
+ * @brief Account the result of a nanoMODBUS request to one sensor
+ * @param seg Segment that ran the request
+ * @param dev Device address (broadcasts are not accounted)
+ * @param err nanoMODBUS error, or exception code (positive)
+ */
+static void lgc_modbus_stats_result(lgc_modbus_segment_t *seg, uint8_t dev, nmbs_error err)
+{
+	lgc_modbus_sensor_stats_t *stats;
+
+	if (dev == 0 || dev > LGC_MODBUS_SENSOR_MAX)
+	{
+		return;
+	}
+
+	if (err == NMBS_ERROR_NONE)
+	{
+		lgc_modbus_stats_reply(dev, seg->rx_cycles - seg->tx_cycles);
+		return;
+	}
+
+	/* transport and argument errors never reached the sensor */
+	stats = &sensor_stats[dev - 1];
+	osAcquireMutex(&stats_mutex);
+	if (err == NMBS_ERROR_TIMEOUT)
+	{
+		stats->timeouts++;
+	}
+	else if (err > 0)
+	{
+		stats->exceptions++;
+	}
+	else if (err != NMBS_ERROR_TRANSPORT && err != NMBS_ERROR_INVALID_ARGUMENT)
+	{
+		stats->crc_errors++;
+	}
+	osReleaseMutex(&stats_mutex);
+}
+
+/**
+ * @brief Account the end of a snapshot or fast round on a segment
+ * @param seg Segment
+ * @param missing Bit i set if sensor i+1 did not answer
+ * @param noise Frames no sensor could be matched to
+ */
+static void lgc_modbus_stats_round(lgc_modbus_segment_t *seg, uint16_t missing, uint32_t noise)
+{
+	osAcquireMutex(&stats_mutex);
+	segment_stats[seg->index].noise += noise;
+	for (uint8_t i = 0; i < LGC_MODBUS_SENSOR_MAX; i++)
+	{
+		if (missing & (1U << i))
+		{
+			sensor_stats[i].timeouts++;
+		}
+	}
+	osReleaseMutex(&stats_mutex);
+}
+
+/**
+ * @brief Account a finished scan transaction on a segment
+ *
+ * The cycle counter wraps every ~24 s at 180 MHz: the system time tells a
+ * pause in the scan apart from a scan period.
+ *
+ * @param seg Segment
+ * @param start DWT stamp of the start of the scan
+ * @param time System time of the start of the scan
+ */
+static void lgc_modbus_stats_scan(lgc_modbus_segment_t *seg, uint32_t start, systime_t time)
+{
+	lgc_modbus_segment_stats_t *stats = &segment_stats[seg->index];
+
+	osAcquireMutex(&stats_mutex);
+	lgc_modbus_stats_time(&stats->scan, lgc_modbus_cycles_us(DWT->CYCCNT - start));
+	if (seg->scan_time != 0 && time - seg->scan_time < LGC_MODBUS_STATS_IDLE_MS)
+	{
+		lgc_modbus_stats_time(&stats->period, lgc_modbus_cycles_us(start - seg->scan_cycles));
+	}
+	osReleaseMutex(&stats_mutex);
+
+	seg->scan_cycles = start;
+	seg->scan_time = time;
+}
+
+/**
+ * @brief Read a burst of slices from a sensor history ring (FC23)
+ * @param seg Segment
+ * @param xfer History transaction (address = since, quantity = max slices)
+ * @return error_t Status of operation
+ */
+static error_t lgc_modbus_history_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer)
+{
+	lgc_modbus_slice_t *slices = (lgc_modbus_slice_t *)xfer->data;
+	uint16_t since = xfer->address;
+	uint16_t quantity;
+	uint16_t count;
+	error_t err;
+
+	xfer->count = 0;
+
+	if (xfer->quantity == 0 || xfer->quantity > LGC_MODBUS_HIST_SLICES_MAX)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	quantity = 2 + LGC_MODBUS_HIST_SLICE_REGS * xfer->quantity;
+
+	nmbs_set_destination_rtu_address(&seg->nmbs, xfer->dev);
+	err = nmbs_read_write_registers(&seg->nmbs, LGC_MODBUS_HIST_BASE_ADDR, quantity, seg->history_regs,
+									LGC_MODBUS_HIST_BASE_ADDR, 1, &since);
+	lgc_modbus_stats_result(seg, xfer->dev, err);
+	if (err != NO_ERROR)
+	{
+		return err;
+	}
+
+	count = seg->history_regs[1];
+	if (count > xfer->quantity)
+	{
+		return ERROR_UNEXPECTED_RESPONSE;
+	}
+
+	for (uint16_t i = 0; i < count; i++)
+	{
+		slices[i].seq = seg->history_regs[2 + LGC_MODBUS_HIST_SLICE_REGS * i];
+		slices[i].value = seg->history_regs[3 + LGC_MODBUS_HIST_SLICE_REGS * i];
+		slices[i].tick = seg->history_regs[4 + LGC_MODBUS_HIST_SLICE_REGS * i];
+	}
+	xfer->count = count;
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief Read the change log of a sensor (FC23)
+ * @param seg Segment
+ * @param xfer Changes transaction (address = since, quantity = max entries)
+ * @return error_t Status of operation
+ */
+static error_t lgc_modbus_changes_execute(lgc_modbus_segment_t *seg, lgc_modbus_xfer_t *xfer)
+{
+	lgc_modbus_changes_t *changes = (lgc_modbus_changes_t *)xfer->data;
+	uint16_t since = xfer->address;
+	uint16_t quantity;
+	uint16_t count;
+	error_t err;
+
+	xfer->count = 0;
+	changes->count = 0;
+
+	if (xfer->quantity == 0 || xfer->quantity > LGC_MODBUS_CHG_ENTRIES_MAX)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	/* shares the history buffer (size checked at compile time) */
+	quantity = LGC_MODBUS_CHG_HEADER_REGS + LGC_MODBUS_CHG_ENTRY_REGS * xfer->quantity;
+
+	nmbs_set_destination_rtu_address(&seg->nmbs, xfer->dev);
+	err = nmbs_read_write_registers(&seg->nmbs, LGC_MODBUS_CHG_BASE_ADDR, quantity, seg->history_regs,
+									LGC_MODBUS_CHG_BASE_ADDR, 1, &since);
+	lgc_modbus_stats_result(seg, xfer->dev, err);
+	if (err != NO_ERROR)
+	{
+		return err;
+	}
+
+	count = seg->history_regs[1] & LGC_MODBUS_CHG_COUNT_MASK;
+	if (count > xfer->quantity)
+	{
+		return ERROR_UNEXPECTED_RESPONSE;
+	}
+
+	changes->head = seg->history_regs[0];
+	changes->lost = (seg->history_regs[1] & LGC_MODBUS_CHG_LOST) ? TRUE : FALSE;
+	changes->more = (seg->history_regs[1] & LGC_MODBUS_CHG_MORE) ? TRUE : FALSE;
+	changes->base = seg->history_regs[2];
+	for (uint16_t i = 0; i < count; i++)
+	{
+		changes->entry[i].seq = seg->history_regs[LGC_MODBUS_CHG_HEADER_REGS + LGC_MODBUS_CHG_ENTRY_REGS * i];
+		changes->entry[i].value = seg->history_regs[LGC_MODBUS_CHG_HEADER_REGS + LGC_MODBUS_CHG_ENTRY_REGS * i + 1];
+	}
+	changes->count = count;
+	xfer->count = count;
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief UART read function for Modbus
+ *
+ * Hands the received frames to nanoMODBUS straight from the circular DMA
+ * buffer. Sleeps on the rx semaphore (posted once per complete frame by the
+ * idle-line callback) only when the current frame is used up.
+ *
+ * @param buffer Pointer to read buffer
+ * @param count Number of bytes to read
+ * @param timeout Read timeout in milliseconds (negative: wait forever)
+ * @param args Additional arguments
+ * @return int32_t Number of bytes read
+ */
+static int32_t lgc_modbus_uart_read(uint8_t *buffer, uint16_t count, int32_t timeout, void *args)
+{
+	lgc_modbus_segment_t *seg = (lgc_modbus_segment_t *)args;
+	systime_t start = osGetSystemTime();
+	systime_t elapsed;
+	uint16_t done = 0;
+	uint16_t len;
+
+	/* Set direction for RS485 transceiver to RX mode */
+	HAL_GPIO_WritePin(seg->de_port, seg->de_pin, GPIO_PIN_RESET);
+
+	while (done < count)
+	{
+		if (seg->rx_span.len == 0)
+		{
+			elapsed = osGetSystemTime() - start;
+			if (timeout >= 0 && elapsed >= (systime_t)timeout)
+			{
+				/* hand over what we have (flush or short frame) */
+				break;
+			}
+			if (lgc_modbus_rx_next(seg, &seg->rx_span, (timeout < 0) ? -1 : (int32_t)(timeout - elapsed)) == FALSE)
+			{
+				break;
+			}
+			seg->rx_cycles = seg->rx_span.stamp;
+			continue;
+		}
+
+		len = (count - done < seg->rx_span.len) ? count - done : seg->rx_span.len;
+		lgc_modbus_rx_copy(seg, &buffer[done], seg->rx_span.start, len);
+		seg->rx_span.start = (seg->rx_span.start + len) % MODBUS_RX_BUFFER_SIZE;
+		seg->rx_span.len -= len;
+		done += len;
+	}
+
+	return (int32_t)done;
+}
+
+/**
+ * @brief UART write function for Modbus
+ * @param buffer Pointer to write buffer
+ * @param count Number of bytes to write
+ * @param timeout Write timeout in milliseconds
+ * @param args Additional arguments
+ * @return int32_t Number of bytes written
+ */
+static int32_t lgc_modbus_uart_write(const uint8_t *buffer, uint16_t count, int32_t timeout, void *args)
+{
+	lgc_modbus_segment_t *seg = (lgc_modbus_segment_t *)args;
+
+	/* nanoMODBUS passes the byte timeout, add the time of the frame itself */
+	timeout += (int32_t)((count * 10UL * 1000UL) / seg->huart->Init.BaudRate) + 1;
+
+	/* RTU framing: t3.5 of silence since the previous frame */
+	lgc_modbus_t35_wait(seg);
+
+	/* Set direction for RS485 transceiver to TX mode */
+	HAL_GPIO_WritePin(seg->de_port, seg->de_pin, GPIO_PIN_SET);
+
+	if (HAL_UART_Transmit(seg->huart, (uint8_t *)buffer, count, timeout) == HAL_OK)
+	{
+		/* Set direction back to RX mode */
+		HAL_GPIO_WritePin(seg->de_port, seg->de_pin, GPIO_PIN_RESET);
+		seg->line_cycles = DWT->CYCCNT;
+		seg->tx_cycles = seg->line_cycles;
+		return (int32_t)count;
+	}
+
+	/* Set direction back to RX mode on error */
+	HAL_GPIO_WritePin(seg->de_port, seg->de_pin, GPIO_PIN_RESET);
+	seg->line_cycles = DWT->CYCCNT;
+
+	return 0;
+}
+
+/**
+ * @brief UART error callback
+ * @param huart UART handle
+ */
+static void lgc_modbus_uart_error_callback(UART_HandleTypeDef *huart)
+{
+	lgc_modbus_segment_t *seg = lgc_modbus_segment_find(huart);
+
+	/* overrun and DMA errors stop the reception, noise/framing errors do not */
+	if (seg != NULL && huart->RxState == HAL_UART_STATE_READY)
+	{
+		lgc_modbus_rx_start(seg);
+	}
+}
+
+/**
+ * @brief UART RX event callback (idle line; half/full transfer are ignored)
+ *
+ * The DMA runs in circular mode and never stops: every idle line closes
+ * the frame that started at the previous one and posts its span.
+ *
+ * @param huart UART handle
+ * @param Pos Current position in DMA buffer
+ */
+static void lgc_modbus_rx_callback(UART_HandleTypeDef *huart, uint16_t Pos)
+{
+	lgc_modbus_segment_t *seg = lgc_modbus_segment_find(huart);
+	uint16_t head = Pos % MODBUS_RX_BUFFER_SIZE;
+	uint16_t len;
+
+	/* Frame still running */
+	if (seg == NULL || HAL_UARTEx_GetRxEventType(huart) != HAL_UART_RXEVENT_IDLE)
+	{
+		return;
+	}
+
+	/* idle fires one character after the last stop bit */
+	seg->line_cycles = DWT->CYCCNT - seg->char_cycles;
+
+	len = (head + MODBUS_RX_BUFFER_SIZE - seg->rx_frame_start) % MODBUS_RX_BUFFER_SIZE;
+	if (len == 0)
+	{
+		return;
+	}
+
+	/* Post the frame, drop it if the task is that far behind */
+	if ((uint16_t)(seg->rx_wr - seg->rx_rd) < MODBUS_RX_FRAMES)
+	{
+		seg->rx_frames[seg->rx_wr % MODBUS_RX_FRAMES].start = seg->rx_frame_start;
+		seg->rx_frames[seg->rx_wr % MODBUS_RX_FRAMES].len = len;
+		seg->rx_frames[seg->rx_wr % MODBUS_RX_FRAMES].stamp = seg->line_cycles;
+		seg->rx_wr++;
+	}
+	seg->rx_frame_start = head;
+
+	/* Release semaphore to signal a complete frame */
+	osReleaseSemaphore(&seg->rx_semaphore);
+}
+
+/**
+ * @brief Start the circular idle-line reception
+ * @param seg Segment
+ * @return HAL_StatusTypeDef Status of operation
+ */
+static HAL_StatusTypeDef lgc_modbus_rx_start(lgc_modbus_segment_t *seg)
+{
+	HAL_StatusTypeDef status;
+
+	seg->rx_frame_start = 0;
+	status = HAL_UARTEx_ReceiveToIdle_DMA(seg->huart, seg->rx_dma, MODBUS_RX_BUFFER_SIZE);
+	if (status == HAL_OK)
+	{
+		/* only idle events close a frame */
+		__HAL_DMA_DISABLE_IT(seg->huart->hdmarx, DMA_IT_HT);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Take the next received frame
+ * @param seg Segment
+ * @param span Output frame span in the DMA buffer
+ * @param timeout Timeout in milliseconds (negative: wait forever)
+ * @return uint8_t TRUE if a frame was taken
+ */
+static uint8_t lgc_modbus_rx_next(lgc_modbus_segment_t *seg, lgc_modbus_span_t *span, int32_t timeout)
+{
+	systime_t start = osGetSystemTime();
+	systime_t elapsed;
+
+	while (seg->rx_rd == seg->rx_wr)
+	{
+		elapsed = osGetSystemTime() - start;
+		if (timeout >= 0 && elapsed >= (systime_t)timeout)
+		{
+			return FALSE;
+		}
+		osWaitForSemaphore(&seg->rx_semaphore, (timeout < 0) ? INFINITE_DELAY : (systime_t)timeout - elapsed);
+	}
+
+	*span = seg->rx_frames[seg->rx_rd % MODBUS_RX_FRAMES];
+	seg->rx_rd++;
+
+	return TRUE;
+}
+
+/**
+ * @brief Copy bytes out of the circular DMA buffer
+ * @param seg Segment
+ * @param dest Destination buffer
+ * @param start Index in the DMA buffer
+ * @param len Number of bytes
+ */
+static void lgc_modbus_rx_copy(lgc_modbus_segment_t *seg, uint8_t *dest, uint16_t start, uint16_t len)
+{
+	uint16_t first = MODBUS_RX_BUFFER_SIZE - start;
+
+	if (len <= first)
+	{
+		memcpy(dest, &seg->rx_dma[start], len);
+	}
+	else
+	{
+		memcpy(dest, &seg->rx_dma[start], first);
+		memcpy(&dest[first], seg->rx_dma, len - first);
+	}
+}
+
+/**
+ * @brief Drop every received frame not consumed yet
+ * @param seg Segment
+ */
+static void lgc_modbus_rx_flush(lgc_modbus_segment_t *seg)
+{
+	while (osWaitForSemaphore(&seg->rx_semaphore, 0) == TRUE)
+		;
+	seg->rx_rd = seg->rx_wr;
+	seg->rx_span.len = 0;
 }
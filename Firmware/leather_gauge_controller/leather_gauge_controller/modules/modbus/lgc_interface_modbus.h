@@ -16,9 +16,299 @@
 
 /*defines*/
 
+/* RS-485 segments: every segment has its own UART, DE pin and modbus task,
+ * segment 0 is the sensor bus on huart3. Sensors are routed to a segment
+ * with lgc_modbus_segment_set() (all on segment 0 by default) */
+#ifndef LGC_MODBUS_SEGMENT_COUNT
+#define LGC_MODBUS_SEGMENT_COUNT 1
+#endif
+#define LGC_MODBUS_SENSOR_MAX 16
+
+/* Snapshot / latch frames (user defined function codes, must match the sensor firmware)
+ * snapshot request (broadcast): [0x00][0x41][seq hi][seq lo][crc lo][crc hi]
+ * snapshot reply (chained)    : [addr][0x41][seq lo][value hi][value lo][crc lo][crc hi]
+ * latch request (broadcast)   : [0x00][0x42][seq hi][seq lo][crc lo][crc hi]
+ * Both requests push the DI value into the sensor history ring tagged with seq.
+ * Sensors answer a snapshot in address order, so they must be addressed 1..N;
+ * with several segments each one runs its own chain (see CHAIN block). */
+#define LGC_MODBUS_FC_SNAPSHOT 0x41
+#define LGC_MODBUS_FC_LATCH 0x42
+#define LGC_MODBUS_SNAPSHOT_REQ_LEN 6
+#define LGC_MODBUS_SNAPSHOT_RSP_LEN 7
+
+/* Sensor sync block (standard Modbus, must match the sensor firmware)
+ * FC06 broadcast to SYNC_ID latches the filtered state of every sensor tagged
+ * with the id; FC03 reads back [id][DI value][D1..D10] */
+#define LGC_MODBUS_SYNC_BASE_ADDR 0x0080
+#define LGC_MODBUS_SYNC_ID_ADDR LGC_MODBUS_SYNC_BASE_ADDR
+#define LGC_MODBUS_SYNC_VALUE_ADDR (LGC_MODBUS_SYNC_BASE_ADDR + 1)
+#define LGC_MODBUS_SYNC_D1_ADDR (LGC_MODBUS_SYNC_BASE_ADDR + 2)
+
+/* Sensor baud rate block (must match the sensor firmware)
+ * FC16 [code][delay ms] to BAUD_CODE switches the rate delay ms after the frame,
+ * FC06 code to BAUD_COMMIT stores it; uncommitted sensors revert on their own */
+#define LGC_MODBUS_BAUD_CODE_ADDR 0x0090
+#define LGC_MODBUS_BAUD_DELAY_ADDR 0x0091
+#define LGC_MODBUS_BAUD_COMMIT_ADDR 0x0092
+
+/* Sensor snapshot chain block (must match the sensor firmware, RAM only)
+ * FC16 [prev][slot]: answer a snapshot after address prev (0: first), slot is
+ * the position in the chain; defaults to address - 1 for both */
+#define LGC_MODBUS_CHAIN_PREV_ADDR 0x00A0
+#define LGC_MODBUS_CHAIN_SLOT_ADDR 0x00A1
+
+/* Fast scan (must match the sensor firmware): FC16 1 to FAST_ENABLE (broadcast)
+ * turns it on, then a 1 byte token [seq lo] latches like a snapshot and the
+ * sensors answer along the same chain with [addr << 2 | value >> 8][value lo][crc8],
+ * crc8 over [seq lo][reply 0][reply 1]. Modbus keeps working in between.
+ * Sensors only take a token 1..16 steps after their last latch (any token
+ * right after the enable), so seq must advance by one per token. */
+#define LGC_MODBUS_FAST_ENABLE_ADDR 0x00B0
+#define LGC_MODBUS_FAST_REQ_LEN 1
+#define LGC_MODBUS_FAST_RSP_LEN 3
+#define LGC_MODBUS_FAST_ADDR_MAX 63
+
+/* Sensor config commit (must match the sensor firmware): configuration writes
+ * (offsets, threshold, fc...) apply at once but stay in sensor RAM; FC16 1 to
+ * CONF_COMMIT stores them in flash, otherwise the sensor does after an idle time */
+#define LGC_MODBUS_CONF_COMMIT_ADDR 0x00C0
+/* ADC hardware oversampling, staged like the rest: [ratio][shift], 2^ratio
+ * conversions per result (0 off, 1-8) shifted right by shift (ratio - shift <= 4);
+ * a pair too slow for the sensor trigger rate is refused */
+#define LGC_MODBUS_CONF_OVS_RATIO_ADDR 0x00C1
+#define LGC_MODBUS_CONF_OVS_SHIFT_ADDR 0x00C2
+
+/* Sensor diagnostics (must match the sensor firmware), FC04 input registers:
+ * [isr last][isr min][isr max] core cycles, [core MHz], [adc blocks], [frames],
+ * [crc errors], [replies], [latency us][latency max us], then from NOISE one
+ * [min][max][rms x16] triplet per channel (adc counts, min/max signed).
+ * Counters wrap; FC06 1 to DIAG_RESET (broadcast ok) restarts min/max values */
+#define LGC_MODBUS_DIAG_ISR_LAST_ADDR 0x0000
+#define LGC_MODBUS_DIAG_CORE_MHZ_ADDR 0x0003
+#define LGC_MODBUS_DIAG_FRAMES_ADDR 0x0005
+#define LGC_MODBUS_DIAG_LATENCY_ADDR 0x0008
+#define LGC_MODBUS_DIAG_NOISE_ADDR 0x0010
+#define LGC_MODBUS_DIAG_NOISE_STRIDE 3
+#define LGC_MODBUS_DIAG_REGS (LGC_MODBUS_DIAG_NOISE_ADDR + LGC_MODBUS_DIAG_NOISE_STRIDE * 10)
+#define LGC_MODBUS_DIAG_RESET_ADDR 0x00D0
+
+/* Sensor history block: write HIST_SINCE, read [head][count][count x (seq, value, tick)] */
+#define LGC_MODBUS_HIST_BASE_ADDR 0x0100
+#define LGC_MODBUS_HIST_SLICE_REGS 3
+#ifndef LGC_MODBUS_HIST_SLICES_MAX
+#define LGC_MODBUS_HIST_SLICES_MAX 32
+#endif
+
+/* Sensor change log block: write CHG_SINCE, read [head][status][value][count x (seq, value)]
+ * value is the DI value at since, every entry holds from its seq on, the DI
+ * value is known up to head. status = count | LOST | MORE */
+#define LGC_MODBUS_CHG_BASE_ADDR 0x0180
+#define LGC_MODBUS_CHG_HEADER_REGS 3
+#define LGC_MODBUS_CHG_ENTRY_REGS 2
+#define LGC_MODBUS_CHG_LOST 0x8000
+#define LGC_MODBUS_CHG_MORE 0x4000
+#define LGC_MODBUS_CHG_COUNT_MASK 0x00FF
+#ifndef LGC_MODBUS_CHG_ENTRIES_MAX
+#define LGC_MODBUS_CHG_ENTRIES_MAX 16
+#endif
+
+/* Reply time histogram: bin 0 below LGC_MODBUS_STATS_BIN0_US, every bin
+ * doubles the edge, the last one is open */
+#define LGC_MODBUS_STATS_BINS 8
+
+#ifndef LGC_MODBUS_STATS_BIN0_US
+#define LGC_MODBUS_STATS_BIN0_US 250
+#endif
+
+/* Scans further apart than this are a pause, not a scan period, milliseconds */
+#ifndef LGC_MODBUS_STATS_IDLE_MS
+#define LGC_MODBUS_STATS_IDLE_MS 1000
+#endif
+
+/*typedefs*/
+typedef enum
+{
+	LGC_MODBUS_XFER_READ_HOLDING = 0,
+	LGC_MODBUS_XFER_READ_COILS,
+	LGC_MODBUS_XFER_WRITE_HOLDING,
+	LGC_MODBUS_XFER_SNAPSHOT,
+	LGC_MODBUS_XFER_LATCH,
+	LGC_MODBUS_XFER_HISTORY,
+	LGC_MODBUS_XFER_SYNC,
+	LGC_MODBUS_XFER_BAUD,
+	LGC_MODBUS_XFER_CHANGES,
+	LGC_MODBUS_XFER_FAST,
+	LGC_MODBUS_XFER_READ_INPUT,
+} lgc_modbus_xfer_type_t;
+
+/* Sensor bus baud rate codes, stored in both configurations */
+typedef enum
+{
+	LGC_MODBUS_BAUD_9600 = 0,
+	LGC_MODBUS_BAUD_19200,
+	LGC_MODBUS_BAUD_38400,
+	LGC_MODBUS_BAUD_57600,
+	LGC_MODBUS_BAUD_115200,
+	LGC_MODBUS_BAUD_230400,
+	LGC_MODBUS_BAUD_460800,
+	LGC_MODBUS_BAUD_921600,
+	LGC_MODBUS_BAUD_MAX,
+} lgc_modbus_baud_t;
+
+/* Rate negotiated on a fresh configuration */
+#ifndef LGC_MODBUS_BAUD_DEFAULT
+#define LGC_MODBUS_BAUD_DEFAULT LGC_MODBUS_BAUD_921600
+#endif
+
+typedef enum
+{
+	LGC_MODBUS_XFER_IDLE = 0,
+	LGC_MODBUS_XFER_QUEUED,
+	LGC_MODBUS_XFER_ACTIVE,
+	LGC_MODBUS_XFER_DONE,
+} lgc_modbus_xfer_state_t;
+
+/* One slice from a sensor history ring */
+typedef struct
+{
+	uint16_t seq;	/* sync sequence (encoder step) */
+	uint16_t value; /* DI bitmap */
+	uint16_t tick;	/* sensor local time, ms */
+} lgc_modbus_slice_t;
+
+/* One entry from a sensor change log */
+typedef struct
+{
+	uint16_t seq;	/* first sync sequence with the new value */
+	uint16_t value; /* DI bitmap from seq on */
+} lgc_modbus_change_t;
+
+/* Reply of a change log read */
+typedef struct
+{
+	uint16_t head;	/* DI value known up to this sequence */
+	uint16_t base;	/* DI value at since */
+	uint8_t lost;	/* changes after since were overwritten, rebuild impossible */
+	uint8_t more;	/* changes after head still pending, read again from head */
+	uint16_t count; /* entries returned */
+	lgc_modbus_change_t entry[LGC_MODBUS_CHG_ENTRIES_MAX];
+} lgc_modbus_changes_t;
+
+/* Running min/avg/max of a time, microseconds */
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum; /* avg = sum / count */
+} lgc_modbus_time_stats_t;
+
+/* Bus statistics of one sensor */
+typedef struct
+{
+	lgc_modbus_time_stats_t rtt; /* end of request to end of reply (count = replies) */
+	uint32_t hist[LGC_MODBUS_STATS_BINS];
+	uint32_t timeouts;	 /* no reply, or missing from a snapshot/fast round */
+	uint32_t crc_errors; /* bad CRC or malformed reply */
+	uint32_t exceptions; /* Modbus exception replies */
+} lgc_modbus_sensor_stats_t;
+
+/* Bus statistics of one RS-485 segment */
+typedef struct
+{
+	lgc_modbus_time_stats_t scan;	/* snapshot/fast/latch transaction time */
+	lgc_modbus_time_stats_t period; /* time between the starts of two scans */
+	uint32_t noise;					/* received frames no sensor could be matched to */
+} lgc_modbus_segment_stats_t;
+
+typedef struct lgc_modbus_xfer lgc_modbus_xfer_t;
+
+/* Completion callback, runs in the modbus task context: keep it short.
+ * It runs after the completion event, with state and result final; it may
+ * resubmit the transaction, which then must not be waited on by another task */
+typedef void (*lgc_modbus_xfer_cb_t)(lgc_modbus_xfer_t *xfer);
+
+/* Asynchronous transaction, owned by the caller until it completes */
+struct lgc_modbus_xfer
+{
+	/*request*/
+	lgc_modbus_xfer_type_t type;
+	uint8_t dev;		/* device address (0: broadcast write on every segment) */
+	uint16_t address;	/* starting address (snapshot/latch/sync/fast: sequence, history/changes: since, baud: code) */
+	uint16_t quantity;	/* registers/coils (snapshot/fast/baud: sensor count, history: max slices, changes: max entries) */
+	void *data;			/* read destination or write source */
+	/*completion*/
+	lgc_modbus_xfer_cb_t callback; /* optional */
+	void *arg;					   /* user argument for the callback */
+	volatile lgc_modbus_xfer_state_t state;
+	volatile error_t result;
+	uint16_t missing; /* snapshot/fast/baud: bit i set if sensor i+1 did not answer */
+	uint16_t count;	  /* history/changes: slices or entries returned */
+	uint8_t segments; /* segments still running the transaction */
+	OsEvent event;
+};
+
 /*public functions*/
 
 error_t lgc_interface_modbus_init(void );
 
+error_t lgc_modbus_xfer_init(lgc_modbus_xfer_t *xfer);
+
+void lgc_modbus_xfer_deinit(lgc_modbus_xfer_t *xfer);
+
+error_t lgc_modbus_submit(lgc_modbus_xfer_t *xfer);
+
+error_t lgc_modbus_wait(lgc_modbus_xfer_t *xfer, systime_t timeout);
+
+error_t lgc_modbus_read_holding_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len);
+
+error_t lgc_modbus_read_coils(uint8_t dev, uint16_t address, uint8_t *coils, size_t len);
+
+error_t lgc_modbus_read_input_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len);
+
+error_t lgc_modbus_write_holding_regs(uint8_t dev, uint16_t address, uint16_t *regs, size_t len);
+
+error_t lgc_modbus_snapshot(uint16_t seq, uint16_t *values, size_t count, uint16_t *missing);
+
+error_t lgc_modbus_latch(uint16_t seq);
+
+error_t lgc_modbus_fast_enable(uint8_t enable);
+
+error_t lgc_modbus_conf_commit(uint8_t dev);
+
+error_t lgc_modbus_oversampling_set(uint8_t dev, uint8_t ratio, uint8_t shift);
+
+error_t lgc_modbus_fast_scan(uint16_t seq, uint16_t *values, size_t count, uint16_t *missing);
+
+error_t lgc_modbus_sync(uint16_t id);
+
+error_t lgc_modbus_read_sync(uint8_t dev, uint16_t id, uint16_t *value);
+
+error_t lgc_modbus_baud_set(uint8_t code);
+
+error_t lgc_modbus_baud_negotiate(uint8_t code, uint8_t count, uint16_t *missing);
+
+uint8_t lgc_modbus_baud_get(void);
+
+error_t lgc_modbus_segment_set(uint8_t dev, uint8_t segment);
+
+uint8_t lgc_modbus_segment_get(uint8_t dev);
+
+error_t lgc_modbus_chain_setup(uint8_t count, uint16_t *missing);
+
+error_t lgc_modbus_read_history(uint8_t dev, uint16_t since, lgc_modbus_slice_t *slices, size_t max, uint16_t *count);
+
+error_t lgc_modbus_read_changes(uint8_t dev, uint16_t since, lgc_modbus_changes_t *changes, size_t max);
+
+error_t lgc_modbus_stats_sensor(uint8_t dev, lgc_modbus_sensor_stats_t *stats);
+
+error_t lgc_modbus_stats_segment(uint8_t segment, lgc_modbus_segment_stats_t *stats);
+
+uint32_t lgc_modbus_stats_avg(const lgc_modbus_time_stats_t *time);
+
+void lgc_modbus_stats_reset(void);
+
+void lgc_modbus_stats_dump(uint8_t count);
+
 
 #endif /* MODULES_MODBUS_LGC_INTERFACE_MODBUS_H_ */
@@ -0,0 +1,142 @@
+/*
+ * lgc_module_slice.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tecna-smart-lab
+ */
+
+#include "lgc_module_slice.h"
+#include <string.h>
+
+/* Sensor value bits that are photoreceptors */
+#define LGC_SLICE_SENSOR_MASK ((1UL << LGC_PHOTORECEPTORS_PER_SENSOR) - 1)
+
+/**
+ * @brief Set bits of a word (SWAR, the M4 has no popcount instruction and
+ *        __builtin_popcount ends in a libgcc call)
+ */
+static inline uint32_t lgc_module_slice_popcount(uint32_t x)
+{
+    x = x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+    x = (x + (x >> 4)) & 0x0F0F0F0FU;
+
+    return (x * 0x01010101U) >> 24;
+}
+
+/**
+ * @brief Build a slice from the sensor DI values
+ * @param slice Output slice
+ * @param sensor DI value of each sensor, bit n is photoreceptor n
+ * @param count Number of sensors (up to LGC_SENSOR_NUMBER)
+ */
+void lgc_module_slice_pack(lgc_slice_t *slice, const uint16_t *sensor, size_t count)
+{
+    uint16_t pixel = 0;
+
+    memset(slice, 0, sizeof(lgc_slice_t));
+
+    if (count > LGC_SENSOR_NUMBER)
+    {
+        count = LGC_SENSOR_NUMBER;
+    }
+
+    for (size_t i = 0; i < count; i++, pixel += LGC_PHOTORECEPTORS_PER_SENSOR)
+    {
+        uint32_t v = sensor[i] & LGC_SLICE_SENSOR_MASK;
+        uint8_t shift = pixel % 32;
+
+        slice->w[pixel / 32] |= v << shift;
+        /* Sensor split across two words */
+        if (shift + LGC_PHOTORECEPTORS_PER_SENSOR > 32)
+        {
+            slice->w[pixel / 32 + 1] |= v >> (32 - shift);
+        }
+    }
+}
+
+/**
+ * @brief State of one photoreceptor
+ * @return uint8_t 1 if the pixel detects leather, 0 otherwise or out of range
+ */
+uint8_t lgc_module_slice_get(const lgc_slice_t *slice, uint16_t pixel)
+{
+    if (pixel >= LGC_SLICE_BITS)
+    {
+        return 0;
+    }
+
+    return (slice->w[pixel / 32] >> (pixel % 32)) & 1U;
+}
+
+/**
+ * @brief Count active photoreceptors
+ * @return uint16_t Number of active pixels (0-LGC_SLICE_BITS)
+ */
+uint16_t lgc_module_slice_count(const lgc_slice_t *slice)
+{
+    uint16_t count = 0;
+
+    for (uint8_t i = 0; i < LGC_SLICE_WORDS; i++)
+    {
+        count += lgc_module_slice_popcount(slice->w[i]);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Pixels active in both slices (out may be a or b)
+ */
+void lgc_module_slice_and(lgc_slice_t *out, const lgc_slice_t *a, const lgc_slice_t *b)
+{
+    for (uint8_t i = 0; i < LGC_SLICE_WORDS; i++)
+    {
+        out->w[i] = a->w[i] & b->w[i];
+    }
+}
+
+/**
+ * @brief Pixels that differ between two slices (out may be a or b)
+ */
+void lgc_module_slice_xor(lgc_slice_t *out, const lgc_slice_t *a, const lgc_slice_t *b)
+{
+    for (uint8_t i = 0; i < LGC_SLICE_WORDS; i++)
+    {
+        out->w[i] = a->w[i] ^ b->w[i];
+    }
+}
+
+/**
+ * @brief First active pixel from pixel 0
+ * @return int16_t Pixel index, -1 if the slice is empty
+ */
+int16_t lgc_module_slice_leftmost(const lgc_slice_t *slice)
+{
+    for (uint8_t i = 0; i < LGC_SLICE_WORDS; i++)
+    {
+        if (slice->w[i] != 0)
+        {
+            return (int16_t)(i * 32 + __builtin_ctz(slice->w[i]));
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Last active pixel (highest index)
+ * @return int16_t Pixel index, -1 if the slice is empty
+ */
+int16_t lgc_module_slice_rightmost(const lgc_slice_t *slice)
+{
+    for (uint8_t i = LGC_SLICE_WORDS; i > 0; i--)
+    {
+        if (slice->w[i - 1] != 0)
+        {
+            return (int16_t)((i - 1) * 32 + 31 - __builtin_clz(slice->w[i - 1]));
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,43 @@
+/*
+ * lgc_module_slice.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tecna-smart-lab
+ */
+
+#ifndef MODULES_SLICE_LGC_MODULE_SLICE_H_
+#define MODULES_SLICE_LGC_MODULE_SLICE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lgc_typedefs.h"
+
+/* Photoreceptors in one slice (one encoder step across the belt) */
+#define LGC_SLICE_BITS (LGC_SENSOR_NUMBER * LGC_PHOTORECEPTORS_PER_SENSOR)
+
+/* 32 bit words holding a slice */
+#define LGC_SLICE_WORDS ((LGC_SLICE_BITS + 31) / 32)
+
+/* Packed slice: pixel p = sensor * LGC_PHOTORECEPTORS_PER_SENSOR + bit (sensor 0
+ * bit 0 is pixel 0, the leftmost) is bit p % 32 of word p / 32. Bits from
+ * LGC_SLICE_BITS up are always 0. */
+typedef struct
+{
+    uint32_t w[LGC_SLICE_WORDS];
+} lgc_slice_t;
+
+void lgc_module_slice_pack(lgc_slice_t *slice, const uint16_t *sensor, size_t count);
+
+uint8_t lgc_module_slice_get(const lgc_slice_t *slice, uint16_t pixel);
+
+uint16_t lgc_module_slice_count(const lgc_slice_t *slice);
+
+void lgc_module_slice_and(lgc_slice_t *out, const lgc_slice_t *a, const lgc_slice_t *b);
+
+void lgc_module_slice_xor(lgc_slice_t *out, const lgc_slice_t *a, const lgc_slice_t *b);
+
+int16_t lgc_module_slice_leftmost(const lgc_slice_t *slice);
+
+int16_t lgc_module_slice_rightmost(const lgc_slice_t *slice);
+
+#endif /* MODULES_SLICE_LGC_MODULE_SLICE_H_ */
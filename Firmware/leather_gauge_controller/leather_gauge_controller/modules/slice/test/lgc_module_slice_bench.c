@@ -0,0 +1,223 @@
+/*
+ * lgc_module_slice_bench.c
+ *
+ * Host check and microbenchmark of the slice module. Every function is
+ * compared with a per-bit reference over random slices (this is the pixel
+ * order contract of lgc_slice_t), then the old per-bit count loop is timed
+ * against pack + count.
+ *
+ * Build and run from modules/slice:
+ *   gcc -O2 -Itest -I. test/lgc_module_slice_bench.c lgc_module_slice.c -o slice_bench
+ *   ./slice_bench
+ *
+ * test/lgc_typedefs.h stands in for app/inc/lgc_typedefs.h, which pulls in
+ * the RTOS port.
+ */
+
+#include "lgc_module_slice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SLICES 4096
+#define BENCH_ROUNDS 2000
+#define BENCH_CHECKS 200000
+
+static uint16_t slices[BENCH_SLICES][LGC_SENSOR_NUMBER];
+
+/* Per-bit loop lgc_count_active_bits used before the packed slice */
+static uint16_t bench_old_count(const uint16_t *sensor)
+{
+    uint16_t count = 0;
+
+    for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+    {
+        uint16_t value = sensor[i];
+
+        for (uint8_t bit = 0; bit < LGC_PHOTORECEPTORS_PER_SENSOR; bit++)
+        {
+            if (value & (1 << bit))
+            {
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+/* Reference pixel: sensor p / 10, bit p % 10 */
+static uint8_t bench_ref_pixel(const uint16_t *sensor, uint16_t pixel)
+{
+    return (sensor[pixel / LGC_PHOTORECEPTORS_PER_SENSOR] >> (pixel % LGC_PHOTORECEPTORS_PER_SENSOR)) & 1U;
+}
+
+static void bench_random(uint16_t *sensor)
+{
+    /* Mostly dense, sometimes sparse or empty, to hit both ends */
+    uint16_t mask = (rand() % 8 == 0) ? (uint16_t)rand() & (uint16_t)rand() : 0xFFFF;
+
+    for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+    {
+        sensor[i] = (uint16_t)rand() & mask;
+    }
+    if (rand() % 64 == 0)
+    {
+        for (uint8_t i = 0; i < LGC_SENSOR_NUMBER; i++)
+        {
+            sensor[i] = 0;
+        }
+    }
+}
+
+static int bench_check(const uint16_t *a, const uint16_t *b)
+{
+    lgc_slice_t sa, sb, out;
+    int16_t left = -1, right = -1;
+
+    lgc_module_slice_pack(&sa, a, LGC_SENSOR_NUMBER);
+    lgc_module_slice_pack(&sb, b, LGC_SENSOR_NUMBER);
+
+    for (uint16_t p = 0; p < LGC_SLICE_BITS; p++)
+    {
+        uint8_t bit = bench_ref_pixel(a, p);
+
+        if (lgc_module_slice_get(&sa, p) != bit)
+        {
+            printf("get: pixel %u\n", p);
+            return 1;
+        }
+        if (bit)
+        {
+            if (left < 0)
+            {
+                left = (int16_t)p;
+            }
+            right = (int16_t)p;
+        }
+    }
+    if (lgc_module_slice_get(&sa, LGC_SLICE_BITS) != 0)
+    {
+        printf("get: out of range pixel\n");
+        return 1;
+    }
+    /* Padding bits above LGC_SLICE_BITS stay 0, the raw bits above the photoreceptors are dropped */
+    if (LGC_SLICE_BITS % 32 && (sa.w[LGC_SLICE_WORDS - 1] >> (LGC_SLICE_BITS % 32)) != 0)
+    {
+        printf("pack: padding bits set\n");
+        return 1;
+    }
+    if (lgc_module_slice_count(&sa) != bench_old_count(a))
+    {
+        printf("count: %u, expected %u\n", lgc_module_slice_count(&sa), bench_old_count(a));
+        return 1;
+    }
+    if (lgc_module_slice_leftmost(&sa) != left || lgc_module_slice_rightmost(&sa) != right)
+    {
+        printf("leftmost/rightmost: %d/%d, expected %d/%d\n", lgc_module_slice_leftmost(&sa),
+               lgc_module_slice_rightmost(&sa), left, right);
+        return 1;
+    }
+
+    lgc_module_slice_and(&out, &sa, &sb);
+    for (uint16_t p = 0; p < LGC_SLICE_BITS; p++)
+    {
+        if (lgc_module_slice_get(&out, p) != (bench_ref_pixel(a, p) & bench_ref_pixel(b, p)))
+        {
+            printf("and: pixel %u\n", p);
+            return 1;
+        }
+    }
+    lgc_module_slice_xor(&out, &sa, &sb);
+    for (uint16_t p = 0; p < LGC_SLICE_BITS; p++)
+    {
+        if (lgc_module_slice_get(&out, p) != (bench_ref_pixel(a, p) ^ bench_ref_pixel(b, p)))
+        {
+            printf("xor: pixel %u\n", p);
+            return 1;
+        }
+    }
+    /* Output aliasing one input */
+    lgc_module_slice_xor(&sa, &sa, &sa);
+    if (lgc_module_slice_count(&sa) != 0)
+    {
+        printf("xor: in place\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    static lgc_slice_t packed[BENCH_SLICES];
+    uint16_t a[LGC_SENSOR_NUMBER], b[LGC_SENSOR_NUMBER];
+    volatile uint32_t sink = 0;
+    double t0, t1, t2, t3, n;
+
+    srand(1);
+    for (uint32_t k = 0; k < BENCH_CHECKS; k++)
+    {
+        bench_random(a);
+        bench_random(b);
+        if (bench_check(a, b))
+        {
+            printf("check FAIL at slice %u\n", k);
+            return 1;
+        }
+    }
+    printf("check, %d random slice pairs: ok\n", BENCH_CHECKS);
+
+    for (uint32_t k = 0; k < BENCH_SLICES; k++)
+    {
+        bench_random(slices[k]);
+    }
+
+    t0 = bench_now();
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t k = 0; k < BENCH_SLICES; k++)
+        {
+            sink += bench_old_count(slices[k]);
+        }
+    }
+    t1 = bench_now();
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t k = 0; k < BENCH_SLICES; k++)
+        {
+            lgc_slice_t slice;
+
+            lgc_module_slice_pack(&slice, slices[k], LGC_SENSOR_NUMBER);
+            sink += lgc_module_slice_count(&slice);
+        }
+    }
+    t2 = bench_now();
+    for (uint32_t k = 0; k < BENCH_SLICES; k++)
+    {
+        lgc_module_slice_pack(&packed[k], slices[k], LGC_SENSOR_NUMBER);
+    }
+    t3 = bench_now();
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t k = 0; k < BENCH_SLICES; k++)
+        {
+            sink += lgc_module_slice_count(&packed[k]);
+        }
+    }
+    n = (double)BENCH_ROUNDS * BENCH_SLICES;
+
+    printf("per slice: old loop %.1f ns, pack + count %.1f ns, count %.1f ns\n", (t1 - t0) / n * 1e9,
+           (t2 - t1) / n * 1e9, (bench_now() - t3) / n * 1e9);
+
+    return 0;
+}
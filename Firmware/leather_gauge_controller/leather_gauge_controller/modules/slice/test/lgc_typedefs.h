@@ -0,0 +1,18 @@
+/*
+ * lgc_typedefs.h
+ *
+ * Host stand-in for app/inc/lgc_typedefs.h: only the sizes the slice module
+ * needs, without the RTOS port. Keep in step with the real header.
+ */
+
+#ifndef LGC_TYPEDEFS_H
+#define LGC_TYPEDEFS_H
+
+#include <stdint.h>
+
+#define LGC_SENSOR_NUMBER 11
+
+/* Number of photoreceptors per sensor */
+#define LGC_PHOTORECEPTORS_PER_SENSOR 10
+
+#endif /* LGC_TYPEDEFS_H */
@@ -14,22 +14,123 @@
 #ifndef LG_ADC_SENAOR_MAX_SIZE
 #define LG_ADC_SENAOR_MAX_SIZE 10
 #endif
+
+/*slices kept in the history ring*/
+#ifndef LG_HISTORY_SIZE
+#define LG_HISTORY_SIZE 32
+#endif
+
+/*noise mean square ema weight: 1 / 2^LG_SENSOR_NOISE_SHIFT per filter sample*/
+#ifndef LG_SENSOR_NOISE_SHIFT
+#define LG_SENSOR_NOISE_SHIFT 6
+#endif
+
+/*entries kept in the change log*/
+#ifndef LG_CHANGE_LOG_SIZE
+#define LG_CHANGE_LOG_SIZE 32
+#endif
 /* ============================================================================
  * typedefs
  * ========================================================================= */
+/*rs485 baud rate codes, stored in the configuration*/
+typedef enum LG_BAUD
+{
+	LG_BAUD_9600 = 0,
+	LG_BAUD_19200,
+	LG_BAUD_38400,
+	LG_BAUD_57600,
+	LG_BAUD_115200,
+	LG_BAUD_230400,
+	LG_BAUD_460800,
+	LG_BAUD_921600,
+	LG_BAUD_MAX,
+} LG_BAUD_t;
 
 typedef struct LG_SENSOR_TypeDef
 {
 	/*adc raw values*/
 	uint16_t raw[LG_ADC_SENAOR_MAX_SIZE];
-	/*adc filter values*/
-	float S[LG_ADC_SENAOR_MAX_SIZE];
+	/*adc filter values, adc counts*/
+	uint16_t S[LG_ADC_SENAOR_MAX_SIZE];
 	/*sensor digital value*/
 	uint16_t value;
-	/*sensor offset aply data*/
-	float D[LG_ADC_SENAOR_MAX_SIZE];
+	/*sensor offset aply data, adc counts*/
+	uint16_t D[LG_ADC_SENAOR_MAX_SIZE];
 } LG_SENSOR_TypeDef_t;
 
+/*detection context used by the adc isr, built from the configuration*/
+typedef struct LG_DETECT_TypeDef
+{
+	/*zero point per channel, adc counts*/
+	int32_t offset[LG_ADC_SENAOR_MAX_SIZE];
+	/*D at or below: photodiode covered, bit set*/
+	int32_t on;
+	/*D at or above: photodiode clear, bit cleared (on + hysteresis)*/
+	int32_t off;
+} LG_DETECT_TypeDef_t;
+
+typedef struct LG_NOISE_TypeDef
+{
+	/*extremes of decimated input - filter output since the reset, adc counts*/
+	int16_t min;
+	int16_t max;
+	/*running mean square of the same residual (1/2^LG_SENSOR_NOISE_SHIFT ema),
+	adc counts^2 scaled by 2^LG_SENSOR_NOISE_SHIFT*/
+	uint32_t ms_acc;
+} LG_NOISE_TypeDef_t;
+
+typedef struct LG_DIAG_TypeDef
+{
+	/*adc block isr cost, core cycles: last, min and max since the reset*/
+	uint16_t isr_last;
+	uint16_t isr_min;
+	uint16_t isr_max;
+	/*adc blocks processed (wraps)*/
+	uint16_t blocks;
+	/*per channel noise*/
+	LG_NOISE_TypeDef_t noise[LG_ADC_SENAOR_MAX_SIZE];
+} LG_DIAG_TypeDef_t;
+
+typedef struct LG_SLICE_TypeDef
+{
+	/*sync sequence (encoder step) of the slice*/
+	uint16_t seq;
+	/*sensor digital value at the sync*/
+	uint16_t value;
+	/*local time of the sync, ms*/
+	uint16_t tick;
+} LG_SLICE_TypeDef_t;
+
+typedef struct LG_CHANGE_TypeDef
+{
+	/*first sync sequence with the new value*/
+	uint16_t seq;
+	/*sensor digital value from seq on*/
+	uint16_t value;
+} LG_CHANGE_TypeDef_t;
+
+typedef struct LG_CHANGES_TypeDef
+{
+	/*newest sequence covered by the entries*/
+	uint16_t head;
+	/*sensor digital value at since, the entries apply on top of it*/
+	uint16_t base;
+	/*entries newer than since were overwritten*/
+	uint8_t lost;
+	/*more entries after head, read again from head*/
+	uint8_t more;
+} LG_CHANGES_TypeDef_t;
+
+typedef struct LG_SYNC_TypeDef
+{
+	/*id of the last sync frame*/
+	uint16_t id;
+	/*sensor digital value at the sync*/
+	uint16_t value;
+	/*offset apply data at the sync*/
+	uint16_t D[LG_ADC_SENAOR_MAX_SIZE];
+} LG_SYNC_TypeDef_t;
+
 
 typedef struct __attribute__((packed)) LG_CONF_TypeDef
 {
@@ -41,6 +142,12 @@ typedef struct __attribute__((packed)) LG_CONF_TypeDef
 	float fc; /*0.1 - 200.0 : 1 - 2000*/
 	/*Threshold data*/
 	uint16_t threshold; /*1-4095*/
+	/*rs485 baud rate code (LG_BAUD_t)*/
+	uint8_t baud;
+	/*adc hardware oversampling: 2^ovs_ratio conversions per result, 0: off*/
+	uint8_t ovs_ratio; /*0-8*/
+	/*oversampled result right shift*/
+	uint8_t ovs_shift; /*0-ovs_ratio*/
 	/*checksum*/
 	uint32_t checksum;
 } LG_CONF_TypeDef_t;
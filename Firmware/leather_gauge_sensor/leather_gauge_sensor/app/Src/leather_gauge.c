@@ -8,6 +8,7 @@
 #include "lg_module_eeprom.h"
 #include "lg_module_sensor.h"
 #include "lg_module_modbus.h"
+#include "stm32g0xx_hal.h"
 /* ============================================================================
  * private functions prototype
  * ========================================================================= */
@@ -27,6 +28,8 @@ uint8_t lg_sensor_init(void)
         return ret;
     }
     lg_module_eeprom_conf_get(&conf);
+    /*detection context before the first conversion*/
+    lg_module_sensor_detect_set(&conf);
     /*sensor init*/
     ret = lg_module_sensor_init(conf.fc);
 
@@ -34,9 +37,24 @@ uint8_t lg_sensor_init(void)
     {
         return ret;
     }
+    /*stored hardware oversampling, a refused pair leaves it off*/
+    if (conf.ovs_ratio != 0 && lg_module_sensor_oversampling_set(conf.ovs_ratio, conf.ovs_shift) != 0)
+    {
+        /*CONF_OVS_* read back the mode that is really active*/
+        conf.ovs_ratio = 0;
+        conf.ovs_shift = 0;
+        lg_module_eeprom_conf_stage(&conf);
+    }
     /*modbus init*/
     ret = lg_module_modbus_init(conf.address);
 
+    if (ret != 0)
+    {
+        return ret;
+    }
+    /*stored rs485 rate, falls back to 9600 on its own*/
+    lg_module_modbus_set_baud(conf.baud);
+
     return ret;
 }
 
@@ -47,8 +65,16 @@ void lg_sensor_run(void)
     /*loop*/
     while (1)
     {
-        /* code */
         lg_module_modbus_pool();
+
+        /*sleep until the next interrupt (rx frame, adc block, systick)*/
+        __disable_irq();
+        if (lg_module_modbus_pending() == 0)
+        {
+            /*a pending interrupt still ends wfi with irq masked, none is lost*/
+            __WFI();
+        }
+        __enable_irq();
     }
 }
 
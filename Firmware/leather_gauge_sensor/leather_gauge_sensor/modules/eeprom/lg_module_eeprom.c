@@ -11,16 +11,33 @@
 #include "lg_module_eeprom.h"
 #include "stm32g0xx_hal.h"
 #include "stm32g0xx_hal_flash.h"
+#include "checksum.h"
 /* ============================================================================
  * defines
  * ========================================================================= */
 // El STM32G030C8 tiene 64KB de Flash.
 // Dirección Base: 0x08000000
-// Última página (Página 31): 0x0800F800 - 0x0800FFFF (2KB)
-#define EEPROM_START_ADDRESS ((uint32_t)0x0800F800)
+// Páginas 30 y 31: 0x0800F000 - 0x0800FFFF (2 x 2KB), fuera del FLASH del linker
+#define EEPROM_START_ADDRESS ((uint32_t)0x0800F000)
 #define EEPROM_PAGE_SIZE ((uint16_t)0x0800) // 2KB (2048 bytes)
+#define EEPROM_FIRST_PAGE 30
+#define EEPROM_PAGES 2
 
-#define CRC32_POLYNOMIAL 0x04C11DB7UL
+/*page written by firmware before the record store (single raw config)*/
+#define EEPROM_LEGACY_ADDRESS (EEPROM_START_ADDRESS + EEPROM_PAGE_SIZE)
+
+/*page header: magic + generation, programmed last when a page is filled*/
+#define EEPROM_PAGE_MAGIC ((uint32_t)0x4C474346) /*"LGCF"*/
+/*record header tag and layout version of LG_CONF_TypeDef_t*/
+#define EEPROM_RECORD_TAG ((uint16_t)0x4C43)
+#define EEPROM_RECORD_VERSION 2
+/*records written before the oversampling fields, converted on load*/
+#define EEPROM_RECORD_VERSION_V1 1
+
+/*one record: header double-word + config padded to double-words*/
+#define EEPROM_RECORD_DW (1 + (sizeof(LG_CONF_TypeDef_t) + 7) / 8)
+#define EEPROM_RECORD_SIZE (EEPROM_RECORD_DW * 8)
+#define EEPROM_RECORDS ((EEPROM_PAGE_SIZE - 8) / EEPROM_RECORD_SIZE)
 
 #ifndef LG_MODBUS_SERVER_DEFAULT_ADDR
 #define LG_MODBUS_SERVER_DEFAULT_ADDR 1
@@ -29,68 +46,107 @@
 #ifndef LB_FILTER_FC_DEFAULT
 #define LB_FILTER_FC_DEFAULT 10.0f
 #endif
+/* ============================================================================
+ * typedefs
+ * ========================================================================= */
+/*layout written by firmware without the baud field*/
+typedef struct __attribute__((packed)) LG_CONF_V0_TypeDef
+{
+	float offset[LG_ADC_SENAOR_MAX_SIZE];
+	uint8_t address;
+	float fc;
+	uint16_t threshold;
+	uint32_t checksum;
+} LG_CONF_V0_TypeDef_t;
+
+/*layout written by firmware without the oversampling fields (record version 1)*/
+typedef struct __attribute__((packed)) LG_CONF_V1_TypeDef
+{
+	float offset[LG_ADC_SENAOR_MAX_SIZE];
+	uint8_t address;
+	float fc;
+	uint16_t threshold;
+	uint8_t baud;
+	uint32_t checksum;
+} LG_CONF_V1_TypeDef_t;
+
+/*first double-word of a store page*/
+typedef struct LG_EEPROM_PAGE_TypeDef
+{
+	uint32_t magic;
+	uint32_t generation;
+} LG_EEPROM_PAGE_TypeDef_t;
+
+/*first double-word of a record, programmed before the config data*/
+typedef struct LG_EEPROM_RECORD_TypeDef
+{
+	uint16_t tag;
+	uint8_t version;
+	uint8_t size;
+	uint32_t seq;
+} LG_EEPROM_RECORD_TypeDef_t;
+
+/*position of the store, found at boot*/
+typedef struct LG_EEPROM_STORE_TypeDef
+{
+	/*active page (0..EEPROM_PAGES-1), EEPROM_PAGES: no valid page*/
+	uint8_t page;
+	/*next free record slot of the active page*/
+	uint8_t next;
+	uint32_t generation;
+	uint32_t seq;
+} LG_EEPROM_STORE_TypeDef_t;
 /* ============================================================================
  * global variables
  * ========================================================================= */
 static LG_CONF_TypeDef_t conf;
 
-static uint64_t ram_page_buffer[EEPROM_PAGE_SIZE / 8];
+static LG_EEPROM_STORE_TypeDef_t store = {.page = EEPROM_PAGES};
+
+/*conf differs from the newest record*/
+static uint8_t dirty = 0;
 
 /* ============================================================================
  * Private function
  * ===========================================================================*/
-static uint8_t lg_module_eeprom_write(uint32_t addr, uint8_t *buffer, uint16_t size);
+static uint8_t lg_module_eeprom_scan(void);
 
-static uint8_t lg_module_eeprom_read(uint32_t addr, uint8_t *buffer, uint16_t size);
+static uint8_t lg_module_eeprom_append(const LG_CONF_TypeDef_t *in);
 
-static uint32_t BSP_CRC32_Calculate(const uint8_t *p_data, size_t length)
-{
-    uint32_t crc = 0xFFFFFFFFUL;
-    size_t i, j;
+static uint8_t lg_module_eeprom_compact(const LG_CONF_TypeDef_t *in);
 
-    if (p_data == NULL || length == 0)
-    {
-        return 0;
-    }
+static uint8_t lg_module_eeprom_record(uint32_t addr, const LG_CONF_TypeDef_t *in);
 
-    for (i = 0; i < length; ++i)
-    {
-        crc ^= p_data[i];
-        for (j = 0; j < 8; ++j)
-        {
-            if (crc & 1)
-            {
-                crc = (crc >> 1) ^ CRC32_POLYNOMIAL;
-            }
-            else
-            {
-                crc >>= 1;
-            }
-        }
-    }
+static uint8_t lg_module_eeprom_legacy(void);
+
+static uint8_t lg_module_eeprom_migrate(void);
+
+static uint8_t lg_module_eeprom_upgrade(const LG_CONF_V1_TypeDef_t *old, LG_CONF_TypeDef_t *out);
+
+static uint8_t lg_module_eeprom_erase(uint8_t page);
+
+static uint8_t lg_module_eeprom_write(uint32_t addr, const uint64_t *dw, uint16_t count);
+
+static uint8_t lg_module_eeprom_read(uint32_t addr, uint8_t *buffer, uint16_t size);
 
-    crc = crc ^ 0xFFFFFFFFUL;
-    return crc;
-}
 /* ============================================================================
  * function definition
  * ========================================================================= */
 /**
- * @brief  Inicializa el módulo (verifica alineación o integridad básica)
+ * @brief  Inicializa el módulo: carga el último registro válido del almacén
  * @retval 0: Éxito, 1: Error
  */
 uint8_t lg_module_eeprom_init(void)
 {
-    uint32_t checksum = 0;
-    /*load configuration*/
-    lg_module_eeprom_read(0, (uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t));
-
-    /*checksum*/
-    checksum = BSP_CRC32_Calculate((const uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t) - 4);
-
-    /*verify */
+    /*latest valid record*/
+    if (lg_module_eeprom_scan() == 0)
+    {
+        /*a record of the previous layout is stored again in the current one*/
+        return lg_module_eeprom_commit();
+    }
 
-    if (checksum != conf.checksum)
+    /*no record yet: config left by the single page firmware, or defaults*/
+    if (lg_module_eeprom_legacy() != 0 && lg_module_eeprom_migrate() != 0)
     {
         /*write default config*/
         memset(&conf, 0, sizeof(LG_CONF_TypeDef_t));
@@ -99,13 +155,11 @@ uint8_t lg_module_eeprom_init(void)
         conf.fc = LB_FILTER_FC_DEFAULT;
         conf.threshold = LB_THRESHOLD_DEFAULT;
         /*calculate checksum*/
-        conf.checksum = BSP_CRC32_Calculate((const uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t) - 4);
-
-        /*Write data*/
-        lg_module_eeprom_write(0, (uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t));
+        conf.checksum = checksum_crc32((const uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t) - 4);
     }
 
-    return 0;
+    /*start the store with it*/
+    return lg_module_eeprom_compact(&conf);
 }
 
 uint8_t lg_module_eeprom_conf_set(LG_CONF_TypeDef_t *in)
@@ -113,12 +167,12 @@ uint8_t lg_module_eeprom_conf_set(LG_CONF_TypeDef_t *in)
     /*Memory copy*/
     memcpy(&conf, in, sizeof(LG_CONF_TypeDef_t));
     /*calculate checksum*/
-    conf.checksum = BSP_CRC32_Calculate((const uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t) - 4);
+    conf.checksum = checksum_crc32((const uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t) - 4);
 
-    /*Write data*/
-    lg_module_eeprom_write(0, (uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t));
+    /*Write data, staged changes go with it*/
+    dirty = 1;
 
-    return 0;
+    return lg_module_eeprom_commit();
 }
 
 uint8_t lg_module_eeprom_conf_get(LG_CONF_TypeDef_t *out)
@@ -127,98 +181,353 @@ uint8_t lg_module_eeprom_conf_get(LG_CONF_TypeDef_t *out)
 
     return 0;
 }
+
+uint8_t lg_module_eeprom_conf_stage(LG_CONF_TypeDef_t *in)
+{
+    /*Memory copy*/
+    memcpy(&conf, in, sizeof(LG_CONF_TypeDef_t));
+    /*calculate checksum*/
+    conf.checksum = checksum_crc32((const uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t) - 4);
+
+    dirty = 1;
+
+    return 0;
+}
+
+uint8_t lg_module_eeprom_commit(void)
+{
+    uint8_t ret;
+
+    if (dirty == 0)
+    {
+        return 0;
+    }
+
+    ret = lg_module_eeprom_append(&conf);
+    if (ret == 0)
+    {
+        dirty = 0;
+    }
+
+    return ret;
+}
+
+uint8_t lg_module_eeprom_dirty(void)
+{
+    return dirty;
+}
 /* ============================================================================
  * private function definition
  * ========================================================================= */
 /**
- * @brief  Lee datos de la Flash emulada.
- * @param  addr: Offset relativo (0 a 2047) desde el inicio de la página emulada.
- * @param  buffer: Puntero donde guardar los datos.
- * @param  size: Cantidad de bytes a leer.
- * @retval 0: Éxito, 1: Error (fuera de rango)
+ * @brief  Find the active page and load its newest valid record
+ * @retval 0: config loaded, 1: no valid record in the store
  */
-static uint8_t lg_module_eeprom_read(uint32_t addr, uint8_t *buffer, uint16_t size)
+static uint8_t lg_module_eeprom_scan(void)
 {
-    // 1. Validación de límites
-    if ((addr + size) > EEPROM_PAGE_SIZE)
+    LG_EEPROM_PAGE_TypeDef_t page;
+    LG_EEPROM_RECORD_TypeDef_t record;
+    LG_CONF_TypeDef_t candidate;
+    LG_CONF_V1_TypeDef_t old;
+    uint8_t found = 1;
+    uint8_t upgraded = 0;
+
+    store.page = EEPROM_PAGES;
+    store.next = 0;
+
+    /*the page with the highest generation is the active one*/
+    for (uint8_t i = 0; i < EEPROM_PAGES; i++)
     {
-        return 1; // Error: Intento de leer fuera de la página reservada
+        lg_module_eeprom_read(i * EEPROM_PAGE_SIZE, (uint8_t *)&page, sizeof(page));
+        if (page.magic != EEPROM_PAGE_MAGIC)
+        {
+            continue;
+        }
+        if (store.page == EEPROM_PAGES || page.generation > store.generation)
+        {
+            store.page = i;
+            store.generation = page.generation;
+        }
+    }
+    if (store.page == EEPROM_PAGES)
+    {
+        return 1;
     }
 
-    // 2. Lectura directa (La flash es memory mapped)
-    // Calculamos la dirección física absoluta
-    uint32_t absolute_addr = EEPROM_START_ADDRESS + addr;
+    /*records are appended in order, the last valid one wins*/
+    for (uint8_t i = 0; i < EEPROM_RECORDS; i++)
+    {
+        uint32_t addr = store.page * EEPROM_PAGE_SIZE + 8 + i * EEPROM_RECORD_SIZE;
 
-    // 3. Copiamos los datos
-    memcpy(buffer, (void *)absolute_addr, size);
+        lg_module_eeprom_read(addr, (uint8_t *)&record, sizeof(record));
+        if (*(const uint64_t *)(EEPROM_START_ADDRESS + addr) == UINT64_MAX)
+        {
+            /*first erased slot: end of the log*/
+            break;
+        }
+        /*a used slot is never reprogrammed, even when its data was cut by a reset*/
+        store.next = i + 1;
 
-    return 0; // Éxito
+        if (record.tag != EEPROM_RECORD_TAG)
+        {
+            continue;
+        }
+        if (record.version == EEPROM_RECORD_VERSION_V1 && record.size == sizeof(LG_CONF_V1_TypeDef_t))
+        {
+            /*previous layout: converted, written back with the next commit*/
+            lg_module_eeprom_read(addr + 8, (uint8_t *)&old, sizeof(old));
+            if (lg_module_eeprom_upgrade(&old, &candidate) != 0)
+            {
+                continue;
+            }
+            upgraded = 1;
+        }
+        else if (record.version == EEPROM_RECORD_VERSION && record.size == sizeof(LG_CONF_TypeDef_t))
+        {
+            lg_module_eeprom_read(addr + 8, (uint8_t *)&candidate, sizeof(candidate));
+            if (checksum_crc32((const uint8_t *)&candidate, sizeof(LG_CONF_TypeDef_t) - 4) != candidate.checksum)
+            {
+                continue;
+            }
+            upgraded = 0;
+        }
+        else
+        {
+            continue;
+        }
+        memcpy(&conf, &candidate, sizeof(LG_CONF_TypeDef_t));
+        store.seq = record.seq;
+        found = 0;
+    }
+    dirty = upgraded;
+
+    return found;
 }
 
 /**
- * @brief  Escribe datos en la Flash emulada (Read-Modify-Write).
- * @param  addr: Offset relativo (0 a 2047).
- * @param  buffer: Datos a escribir.
- * @param  size: Cantidad de bytes.
+ * @brief  Append a record to the active page, compacting only when it is full
  * @retval 0: Éxito, Other: Error HAL
  */
-static uint8_t lg_module_eeprom_write(uint32_t addr, uint8_t *buffer, uint16_t size)
+static uint8_t lg_module_eeprom_append(const LG_CONF_TypeDef_t *in)
 {
-    HAL_StatusTypeDef status;
-    uint32_t page_error = 0;
-    FLASH_EraseInitTypeDef erase_init;
+    if (store.page == EEPROM_PAGES || store.next >= EEPROM_RECORDS)
+    {
+        return lg_module_eeprom_compact(in);
+    }
 
-    // 1. Validación de límites
-    if ((addr + size) > EEPROM_PAGE_SIZE)
+    uint32_t addr = store.page * EEPROM_PAGE_SIZE + 8 + store.next * EEPROM_RECORD_SIZE;
+    /*the slot is spent whatever the result*/
+    store.next++;
+    if (lg_module_eeprom_record(addr, in) != 0)
     {
-        return 1; // Error: Fuera de rango
+        /*slot not blank (cut write): retry on a fresh page*/
+        return lg_module_eeprom_compact(in);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief  Erase the other page, write the record and then its page header
+ * @note   Until the header is programmed the previous page stays active,
+ *         a reset in between loses nothing.
+ * @retval 0: Éxito, Other: Error HAL
+ */
+static uint8_t lg_module_eeprom_compact(const LG_CONF_TypeDef_t *in)
+{
+    uint8_t target = (store.page == 0) ? 1 : 0;
+    uint32_t generation = (store.page == EEPROM_PAGES) ? 1 : store.generation + 1;
+    LG_EEPROM_PAGE_TypeDef_t page = {.magic = EEPROM_PAGE_MAGIC, .generation = generation};
+    uint64_t dw;
+    uint8_t ret;
+
+    ret = lg_module_eeprom_erase(target);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    ret = lg_module_eeprom_record(target * EEPROM_PAGE_SIZE + 8, in);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    memcpy(&dw, &page, sizeof(dw));
+    ret = lg_module_eeprom_write(target * EEPROM_PAGE_SIZE, &dw, 1);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    store.page = target;
+    store.generation = generation;
+    store.next = 1;
+
+    return 0;
+}
+
+/**
+ * @brief  Program one record: header double-word first, then the config
+ * @retval 0: Éxito, Other: Error HAL
+ */
+static uint8_t lg_module_eeprom_record(uint32_t addr, const LG_CONF_TypeDef_t *in)
+{
+    uint64_t dw[EEPROM_RECORD_DW];
+    LG_EEPROM_RECORD_TypeDef_t record = {
+        .tag = EEPROM_RECORD_TAG,
+        .version = EEPROM_RECORD_VERSION,
+        .size = sizeof(LG_CONF_TypeDef_t),
+        .seq = store.seq + 1,
+    };
+
+    /*padding stays erased*/
+    memset(dw, 0xFF, sizeof(dw));
+    memcpy(&dw[0], &record, sizeof(record));
+    memcpy(&dw[1], in, sizeof(LG_CONF_TypeDef_t));
+
+    store.seq = record.seq;
+
+    return lg_module_eeprom_write(addr, dw, EEPROM_RECORD_DW);
+}
+
+/**
+ * @brief  Load the raw config written at the start of page 31 by the single page firmware
+ * @retval 0: loaded, 1: no valid config there
+ */
+static uint8_t lg_module_eeprom_legacy(void)
+{
+    LG_CONF_V1_TypeDef_t old;
+
+    /*that firmware already had the baud field*/
+    memcpy(&old, (const void *)EEPROM_LEGACY_ADDRESS, sizeof(LG_CONF_V1_TypeDef_t));
+
+    return lg_module_eeprom_upgrade(&old, &conf);
+}
+
+/**
+ * @brief  Convert a configuration stored with the previous layout
+ * @retval 0: migrated, 1: no valid previous layout
+ */
+static uint8_t lg_module_eeprom_migrate(void)
+{
+    LG_CONF_V0_TypeDef_t old;
+
+    memcpy(&old, (const void *)EEPROM_LEGACY_ADDRESS, sizeof(LG_CONF_V0_TypeDef_t));
+
+    if (checksum_crc32((const uint8_t *)&old, sizeof(LG_CONF_V0_TypeDef_t) - 4) != old.checksum)
+    {
+        return 1;
     }
 
-    // 2. Copiar TODA la página actual de Flash a RAM (Backup)
-    // Usamos punteros para asegurar el copiado correcto al array de uint64_t
-    memcpy(ram_page_buffer, (void *)EEPROM_START_ADDRESS, EEPROM_PAGE_SIZE);
+    memset(&conf, 0, sizeof(LG_CONF_TypeDef_t));
+    memcpy(conf.offset, old.offset, sizeof(conf.offset));
+    conf.address = old.address;
+    conf.fc = old.fc;
+    conf.threshold = old.threshold;
+    conf.baud = LG_BAUD_9600;
+    conf.ovs_ratio = 0;
+    conf.ovs_shift = 0;
+    conf.checksum = checksum_crc32((const uint8_t *)&conf, sizeof(LG_CONF_TypeDef_t) - 4);
 
-    // 3. Modificar solo los bytes necesarios en el buffer de RAM
-    // Casteamos a uint8_t* para movernos byte a byte en el buffer
-    uint8_t *byte_ptr = (uint8_t *)ram_page_buffer;
-    memcpy(&byte_ptr[addr], buffer, size);
+    return 0;
+}
+
+/**
+ * @brief  Convert a record written with the layout before the oversampling fields
+ * @retval 0: converted, 1: checksum error
+ */
+static uint8_t lg_module_eeprom_upgrade(const LG_CONF_V1_TypeDef_t *old, LG_CONF_TypeDef_t *out)
+{
+    if (checksum_crc32((const uint8_t *)old, sizeof(LG_CONF_V1_TypeDef_t) - 4) != old->checksum)
+    {
+        return 1;
+    }
+
+    /*oversampling off: same acquisition as before*/
+    memset(out, 0, sizeof(LG_CONF_TypeDef_t));
+    memcpy(out->offset, old->offset, sizeof(out->offset));
+    out->address = old->address;
+    out->fc = old->fc;
+    out->threshold = old->threshold;
+    out->baud = old->baud;
+    out->checksum = checksum_crc32((const uint8_t *)out, sizeof(LG_CONF_TypeDef_t) - 4);
+
+    return 0;
+}
+
+/**
+ * @brief  Borra una página del almacén.
+ * @param  page: Página del almacén (0 a EEPROM_PAGES - 1).
+ * @retval 0: Éxito, 2: Error al borrar
+ */
+static uint8_t lg_module_eeprom_erase(uint8_t page)
+{
+    HAL_StatusTypeDef status;
+    uint32_t page_error = 0;
+    FLASH_EraseInitTypeDef erase_init;
 
-    // 4. Desbloquear la Flash para escritura
     HAL_FLASH_Unlock();
 
-    // 5. Borrar la página de Flash
     erase_init.TypeErase = FLASH_TYPEERASE_PAGES;
     erase_init.Banks = FLASH_BANK_1;
-    erase_init.Page = 31; // Página 31 es la última en 64KB (0x0800F800)
+    erase_init.Page = EEPROM_FIRST_PAGE + page;
     erase_init.NbPages = 1;
 
     status = HAL_FLASHEx_Erase(&erase_init, &page_error);
-    if (status != HAL_OK)
+
+    HAL_FLASH_Lock();
+
+    return (status != HAL_OK) ? 2 : 0;
+}
+
+/**
+ * @brief  Programa double-words en páginas ya borradas (sin Read-Modify-Write).
+ * @param  addr: Offset relativo desde el inicio del almacén, alineado a 8.
+ * @param  dw: Datos a escribir.
+ * @param  count: Cantidad de double-words.
+ * @retval 0: Éxito, 1: Error (fuera de rango), 3: Error al escribir
+ */
+static uint8_t lg_module_eeprom_write(uint32_t addr, const uint64_t *dw, uint16_t count)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    // 1. Validación de límites
+    if ((addr % 8) != 0 || (addr + count * 8) > EEPROM_PAGES * EEPROM_PAGE_SIZE)
     {
-        HAL_FLASH_Lock();
-        return 2; // Error al borrar
+        return 1; // Error: Fuera de rango
     }
 
-    // 6. Escribir el buffer RAM actualizado de vuelta a la Flash
+    HAL_FLASH_Unlock();
+
     // El STM32G0 requiere escritura de DoubleWord (64 bits)
-    for (uint32_t i = 0; i < (EEPROM_PAGE_SIZE / 8); i++)
+    for (uint16_t i = 0; i < count && status == HAL_OK; i++)
     {
-        // Calculamos la dirección absoluta de destino
-        uint32_t dest_addr = EEPROM_START_ADDRESS + (i * 8);
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, EEPROM_START_ADDRESS + addr + i * 8, dw[i]);
+    }
 
-        // Obtenemos el dato de 64 bits del buffer
-        uint64_t data = ram_page_buffer[i];
+    HAL_FLASH_Lock();
 
-        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, dest_addr, data);
-        if (status != HAL_OK)
-        {
-            HAL_FLASH_Lock();
-            return 3; // Error al escribir
-        }
+    return (status != HAL_OK) ? 3 : 0;
+}
+
+/**
+ * @brief  Lee datos de la Flash emulada.
+ * @param  addr: Offset relativo (0 a 4095) desde el inicio del almacén.
+ * @param  buffer: Puntero donde guardar los datos.
+ * @param  size: Cantidad de bytes a leer.
+ * @retval 0: Éxito, 1: Error (fuera de rango)
+ */
+static uint8_t lg_module_eeprom_read(uint32_t addr, uint8_t *buffer, uint16_t size)
+{
+    // 1. Validación de límites
+    if ((addr + size) > EEPROM_PAGES * EEPROM_PAGE_SIZE)
+    {
+        return 1; // Error: Intento de leer fuera del almacén
     }
 
-    // 7. Bloquear la Flash
-    HAL_FLASH_Lock();
+    // 2. Lectura directa (La flash es memory mapped)
+    memcpy(buffer, (void *)(EEPROM_START_ADDRESS + addr), size);
 
     return 0; // Éxito
 }
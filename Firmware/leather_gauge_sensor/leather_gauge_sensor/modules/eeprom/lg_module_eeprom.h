@@ -27,4 +27,12 @@ uint8_t lg_module_eeprom_conf_set(LG_CONF_TypeDef_t *in);
 
 uint8_t lg_module_eeprom_conf_get(LG_CONF_TypeDef_t *out);
 
+/*ram only, lg_module_eeprom_commit stores it*/
+uint8_t lg_module_eeprom_conf_stage(LG_CONF_TypeDef_t *in);
+
+uint8_t lg_module_eeprom_commit(void);
+
+/*1 while staged changes are not in flash*/
+uint8_t lg_module_eeprom_dirty(void);
+
 #endif /* MODULES_EEPROM_LG_MODULE_EEPROM_H_ */
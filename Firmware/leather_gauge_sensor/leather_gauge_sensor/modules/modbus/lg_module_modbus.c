@@ -6,6 +6,7 @@
  * ========================================================================= */
 #include "lg_module_modbus.h"
 #include "lwrb.h"
+#include "checksum.h"
 #include "usart.h"
 #include "gpio.h"
 #include "lg_module_eeprom.h"
@@ -19,10 +20,95 @@
 
 #define COILS_ADDR_MAX LG_ADC_SENAOR_MAX_SIZE
 
+/*FC03 read of DI_VALUE alone, answered from the rx isr*/
+#define LG_MODBUS_DI_REQ_LEN 8
+#define LG_MODBUS_DI_RSP_LEN 7
+
+/*extra time per snapshot reply slot (turnaround + isr latency)*/
+#ifndef LG_SNAPSHOT_GUARD_US
+#define LG_SNAPSHOT_GUARD_US 500
+#endif
+
+/*time a new baud rate waits for its commit before reverting*/
+#ifndef LG_BAUD_TRIAL_MS
+#define LG_BAUD_TRIAL_MS 2000
+#endif
+
+/*invalid frames in a row (no valid one between) before trying 9600*/
+#ifndef LG_BAUD_GARBAGE_MIN
+#define LG_BAUD_GARBAGE_MIN 3
+#endif
+
+/*staged configuration goes to flash after this long without configuration writes*/
+#ifndef LG_CONF_COMMIT_IDLE_MS
+#define LG_CONF_COMMIT_IDLE_MS 10000
+#endif
+
+/*fast scan tokens taken this many steps after the last latch at most*/
+#ifndef LG_MODBUS_FAST_SEQ_WINDOW
+#define LG_MODBUS_FAST_SEQ_WINDOW 16
+#endif
+
+#ifndef LG_MODBUS_READ_TIMEOUT
+#define LG_MODBUS_READ_TIMEOUT 1000
+#endif
+
 
 /* ============================================================================
  * typedefs
  * ========================================================================= */
+typedef struct
+{
+	/*latched reply, ready to send (snapshot or fast scan)*/
+	uint8_t frame[LG_MODBUS_SNAPSHOT_RSP_LEN];
+	uint8_t len;
+	/*sequence of the active snapshot (low byte)*/
+	uint8_t seq;
+	/*last latched sequence, a fast scan token only carries its low byte*/
+	uint16_t last_seq;
+	/*fast scan tokens answered*/
+	uint8_t fast;
+	/*next token taken whatever its seq (set by the enable)*/
+	uint8_t fast_sync;
+	/*reply waiting for our turn*/
+	volatile uint8_t pending;
+	/*fallback instant to answer if the previous sensor is silent*/
+	volatile uint32_t deadline_us;
+	/*chain set by the controller: predecessor address and slot on the segment*/
+	uint8_t chained;
+	uint8_t prev;
+	uint8_t slot;
+} lg_snapshot_t;
+
+typedef struct
+{
+	/*current and stored (committed) rate codes*/
+	uint8_t code;
+	uint8_t stored;
+	/*rate restored if the trial is not committed*/
+	uint8_t prev;
+	/*scheduled switch, LG_BAUD_MAX if none*/
+	uint8_t next;
+	uint8_t trial;
+	uint32_t switch_tick;
+	uint32_t trial_tick;
+	/*frames that are not valid since the last valid one (other rate on the bus)*/
+	volatile uint8_t garbage;
+} lg_baud_t;
+
+typedef struct
+{
+	/*wrapping counters*/
+	uint16_t frames;
+	uint16_t crc_errors;
+	uint16_t replies;
+	uint16_t line_errors;
+	/*end of the request being served*/
+	uint32_t rx_end_us;
+	/*end of request to start of reply, us*/
+	uint16_t latency_us;
+	uint16_t latency_max_us;
+} lg_diag_t;
 
 /* ============================================================================
  * global variables
@@ -31,12 +117,37 @@ static uint8_t rx_buffer[LG_UART_RX_BUFFER_SIZE];
 static lwrb_t rb;
 static uint8_t rb_buffer[LG_UART_RX_BUFFER_SIZE * 2];
 
-static nmbs_bitfield server_coils = {0};
-static uint16_t server_registers[LB_MODBUS_ADDR_MAX + 1] = {0};
+/*config registers, only rebuilt when a write changes the configuration*/
+static uint16_t conf_registers[FACTORY_RESET_ADDR] = {0};
 
 static nmbs_platform_conf platform_conf;
 static nmbs_callbacks callbacks;
 static nmbs_t nmbs;
+
+static lg_snapshot_t snapshot;
+static lg_baud_t baud = {.next = LG_BAUD_MAX};
+static const uint32_t baud_rates[LG_BAUD_MAX] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+/*history read start, written through HIST_SINCE*/
+static uint16_t history_since = 0;
+/*history read scratch, off the 1 KB stack (main loop only)*/
+static LG_SLICE_TypeDef_t history_slices[LG_HISTORY_SIZE];
+/*change log read start, written through CHG_SINCE*/
+static uint16_t changes_since = 0;
+/*change log read scratch, off the 1 KB stack (main loop only)*/
+static LG_CHANGE_TypeDef_t changes_entries[LG_CHANGE_LOG_SIZE];
+/*DI_VALUE request and its reply, rebuilt on address and value changes*/
+static uint8_t di_request[LG_MODBUS_DI_REQ_LEN];
+static uint8_t di_reply[LG_MODBUS_DI_RSP_LEN];
+/*crc16 of the constant reply header [addr][0x03][0x02]*/
+static uint16_t di_crc;
+/*copy on the wire, the adc isr keeps di_reply current during the transfer*/
+static uint8_t di_tx[LG_MODBUS_DI_RSP_LEN];
+/*last staged configuration write*/
+static uint32_t conf_tick = 0;
+/*complete frames in the ring buffer, counted by the receiver timeout isr*/
+static volatile uint8_t rx_frames = 0;
+/*bus statistics, FC04 diagnostics block*/
+static lg_diag_t diag = {0};
 /* ============================================================================
  * private function prototype
  * ========================================================================= */
@@ -55,8 +166,45 @@ static nmbs_error handle_write_multiple_registers(uint16_t address, uint16_t qua
 		uint8_t unit_id, void *arg);
 static nmbs_error handle_write_single_register(uint16_t address, uint16_t value,
 		uint8_t unit_id, void *arg);
+static nmbs_error handle_read_history(uint16_t address, uint16_t quantity, uint16_t *registers_out);
+static nmbs_error handle_read_changes(uint16_t address, uint16_t quantity, uint16_t *registers_out);
+static nmbs_error handle_read_sync(uint16_t address, uint16_t quantity, uint16_t *registers_out);
+static nmbs_error handle_read_baud(uint16_t address, uint16_t quantity, uint16_t *registers_out);
+static nmbs_error handle_write_baud(uint16_t address, uint16_t quantity, const uint16_t *registers);
+static nmbs_error handle_read_chain(uint16_t address, uint16_t quantity, uint16_t *registers_out);
+static nmbs_error handle_write_chain(uint16_t address, uint16_t quantity, const uint16_t *registers);
+static nmbs_error handle_read_fast(uint16_t address, uint16_t quantity, uint16_t *registers_out);
+static nmbs_error handle_write_fast(uint16_t address, uint16_t quantity, const uint16_t *registers);
+static nmbs_error handle_read_conf(uint16_t address, uint16_t quantity, uint16_t *registers_out);
+static nmbs_error handle_read_input_registers(uint16_t address, uint16_t quantity, uint16_t *registers_out, uint8_t unit_id,
+		void *arg);
+static nmbs_error handle_write_conf(uint16_t address, uint16_t quantity, const uint16_t *registers);
 
-static void modbus_server_update(void);
+static void modbus_conf_update(void);
+static uint16_t modbus_register_get(uint16_t address);
+
+static uint32_t lg_module_time_us(void);
+static uint8_t lg_module_frame_valid(const uint8_t *buf, uint16_t len);
+static uint32_t lg_module_t35_us(void);
+static void lg_module_rx_start(void);
+static void lg_module_rx_frame(uint16_t size);
+static void lg_module_baud_apply(uint8_t code);
+static void lg_module_baud_poll(void);
+static void lg_module_baud_garbage(void);
+static void lg_module_conf_poll(void);
+static void lg_module_diag_reply(void);
+static uint16_t lg_module_isqrt(uint64_t value);
+static uint8_t lg_module_sync_frame(const uint8_t *buf, uint16_t len);
+static uint8_t lg_module_snapshot_frame(const uint8_t *buf, uint16_t len);
+static uint8_t lg_module_fast_frame(const uint8_t *buf, uint16_t len);
+static uint8_t lg_module_di_frame(const uint8_t *buf, uint16_t len);
+static void lg_module_di_build(uint8_t addr);
+static void lg_module_di_update(uint16_t value);
+static void lg_module_chain_start(uint8_t len);
+static void lg_module_chain_heard(uint8_t addr);
+static uint32_t lg_module_chain_slot_us(void);
+static void lg_module_snapshot_send(void);
+static void lg_module_snapshot_poll(void);
 nmbs_error modbus_tcp_write_data(uint16_t address, uint16_t val);
 /* ============================================================================
  * public function definition
@@ -67,26 +215,28 @@ uint8_t lg_module_modbus_init(uint8_t addr)
 
 	/*ring buffer init*/
 	lwrb_init(&rb, rb_buffer, LG_UART_RX_BUFFER_SIZE);
-	/*start rx with uart*/
+	/*rx direction, reception starts with the baud rate below*/
 	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
 
-	HAL_UARTEx_ReceiveToIdle_DMA(&huart1, rx_buffer, LG_UART_RX_BUFFER_SIZE);
-
 	/*modbus server init*/
 	nmbs_platform_conf_create(&platform_conf);
 	platform_conf.transport = NMBS_TRANSPORT_RTU;
 	platform_conf.read = lg_module_read_serial;
 	platform_conf.write = lg_module_write_serial;
 	platform_conf.arg = NULL;
+	platform_conf.crc_calc = checksum_nmbs_crc16;
 
+	/*function codes without a handler here (02, 05, 20, 21, 23, 43) and the client are
+	  compiled out of nanomodbus with NMBS_*_DISABLED in the project symbols*/
 	nmbs_callbacks_create(&callbacks);
 	callbacks.read_coils = handle_read_coils;
 	callbacks.write_multiple_coils = handle_write_multiple_coils;
 	callbacks.read_holding_registers = handler_read_holding_registers;
+	callbacks.read_input_registers = handle_read_input_registers;
 	callbacks.write_multiple_registers = handle_write_multiple_registers;
 	callbacks.write_single_register = handle_write_single_register;
 
-	nmbs_bitfield_set(server_coils, 0);
+	modbus_conf_update();
 
 	nmbs_error err = nmbs_server_create(&nmbs, addr, &platform_conf, &callbacks);
 	if (err != NMBS_ERROR_NONE)
@@ -94,8 +244,9 @@ uint8_t lg_module_modbus_init(uint8_t addr)
 		return 1;
 	}
 
-	nmbs_set_read_timeout(&nmbs, 1000);
-	nmbs_set_byte_timeout(&nmbs, 1000);
+	nmbs_set_read_timeout(&nmbs, LG_MODBUS_READ_TIMEOUT);
+	lg_module_di_build(addr);
+	lg_module_baud_apply(LG_BAUD_9600);
 
 	return ret;
 }
@@ -105,66 +256,137 @@ uint8_t lg_module_modbus_set_addr(uint8_t addr)
 	uint8_t ret = 0;
 
 	nmbs.address_rtu = addr;
+	lg_module_di_build(addr);
 
 	return ret;
 }
 
-uint8_t lg_module_modbus_pool(void)
+void lg_module_sensor_value_callback(uint16_t value)
 {
-	nmbs_error err = nmbs_server_poll(&nmbs);
-	if (err != NMBS_ERROR_NONE)
+	lg_module_di_update(value);
+}
+
+uint8_t lg_module_modbus_set_baud(uint8_t code)
+{
+	if (code >= LG_BAUD_MAX)
 	{
 		return 1;
 	}
 
+	baud.stored = code;
+	baud.trial = 0;
+	baud.next = LG_BAUD_MAX;
+	lg_module_baud_apply(code);
+
 	return 0;
 }
+
+uint8_t lg_module_modbus_pool(void)
+{
+	nmbs_error err = NMBS_ERROR_NONE;
+
+	lg_module_snapshot_poll();
+	lg_module_baud_poll();
+	lg_module_conf_poll();
+
+	if (rx_frames == 0)
+	{
+		return 0;
+	}
+
+	/*the whole frame is in the ring buffer, nanoMODBUS never waits on it*/
+	__disable_irq();
+	rx_frames--;
+	__enable_irq();
+
+	err = nmbs_server_poll(&nmbs);
+
+	/*leftovers of a malformed frame must not prefix the next one*/
+	__disable_irq();
+	if (rx_frames == 0)
+	{
+		lwrb_reset(&rb);
+	}
+	__enable_irq();
+
+	return (err != NMBS_ERROR_NONE) ? 1 : 0;
+}
+
+uint8_t lg_module_modbus_pending(void)
+{
+	/*a snapshot fallback slot has us resolution, no sleep until it is sent*/
+	return (rx_frames != 0 || snapshot.pending) ? 1 : 0;
+}
 /* ============================================================================
  * private function definition
  * ========================================================================= */
 
 void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
 {
-	HAL_UARTEx_ReceiveToIdle_DMA(&huart1, rx_buffer, LG_UART_RX_BUFFER_SIZE);
+	/*bytes in the buffer when the reception stopped*/
+	uint16_t size = LG_UART_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(huart->hdmarx);
 
-	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
+	/*parity/noise/framing/overrun: the crc of the frame decides, another rate
+	on the bus shows up as frames that keep failing it*/
+	if (huart->ErrorCode & (HAL_UART_ERROR_PE | HAL_UART_ERROR_NE | HAL_UART_ERROR_FE | HAL_UART_ERROR_ORE))
+	{
+		diag.line_errors++;
+	}
+
+	if (huart->ErrorCode & HAL_UART_ERROR_RTO)
+	{
+		/*t3.5 of silence after the last byte: the frame is complete*/
+		lg_module_rx_frame(size);
+	}
+	else if (size < LG_UART_RX_BUFFER_SIZE)
+	{
+		/*any error stops the dma mid frame: go on after the bytes already in*/
+		HAL_UART_Receive_DMA(&huart1, &rx_buffer[size], LG_UART_RX_BUFFER_SIZE - size);
+		return;
+	}
+	else
+	{
+		/*buffer full, hand it over like a complete transfer*/
+		lwrb_write(&rb, rx_buffer, LG_UART_RX_BUFFER_SIZE);
+	}
+
+	lg_module_rx_start();
 }
 
-void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-	/*write to ring buffer*/
-	lwrb_write(&rb, rx_buffer, Size);
-	/*Receive another data*/
-	HAL_UARTEx_ReceiveToIdle_DMA(&huart1, rx_buffer, LG_UART_RX_BUFFER_SIZE);
+	/*frame longer than the buffer: hand over this part, the rest ends on the receiver timeout*/
+	lwrb_write(&rb, rx_buffer, LG_UART_RX_BUFFER_SIZE);
 
-	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
+	lg_module_rx_start();
+}
 
-	return;
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	/*snapshot reply sent, back to rx*/
+	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
 }
 
 static int32_t lg_module_read_serial(uint8_t *buf, uint16_t count, int32_t byte_timeout_ms, void *arg)
 {
-	uint32_t ticks = HAL_GetTick();
-
-	while ((HAL_GetTick() - ticks) <= byte_timeout_ms)
-	{
-		if (lwrb_get_full(&rb) >= count)
-		{
-			// read
-			return lwrb_read(&rb, buf, count);
-		}
-	}
-
-	return 0;
+	/*only called with a complete frame buffered: a short read is a short frame*/
+	return (int32_t)lwrb_read(&rb, buf, count);
 }
 
 static int32_t lg_module_write_serial(const uint8_t *buf, uint16_t count, int32_t byte_timeout_ms, void *arg)
 {
 	int32_t ret = count;
+
+	/*the rx isr updates the same counters*/
+	__disable_irq();
+	lg_module_diag_reply();
+	__enable_irq();
 	// set output dir
 	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_SET);
 
-	if (HAL_UART_Transmit(&huart1, buf, count, byte_timeout_ms) != HAL_OK)
+	/*nanoMODBUS passes the byte timeout, add the time of the frame itself*/
+	uint32_t timeout = byte_timeout_ms + (count * 10U * 1000U) / huart1.Init.BaudRate + 1U;
+	if (HAL_UART_Transmit(&huart1, buf, count, timeout) != HAL_OK)
 	{
 		ret = 0;
 	}
@@ -179,13 +401,11 @@ static nmbs_error handle_read_coils(uint16_t address, uint16_t quantity, nmbs_bi
 	if (address + quantity > COILS_ADDR_MAX + 1)
 		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
 
-	// update current data
-	modbus_server_update();
-	// Read our coils values into coils_out
+	/*coils are the bits of the digital value*/
+	uint16_t value = lg_module_sensor_value_get();
 	for (int i = 0; i < quantity; i++)
 	{
-		bool value = nmbs_bitfield_read(server_coils, address + i);
-		nmbs_bitfield_write(coils_out, i, value);
+		nmbs_bitfield_write(coils_out, i, (value >> (address + i)) & 1U);
 	}
 
 	return NMBS_ERROR_NONE;
@@ -197,26 +417,46 @@ static nmbs_error handle_write_multiple_coils(uint16_t address, uint16_t quantit
 	if (address + quantity > COILS_ADDR_MAX + 1)
 		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
 
-	// Write coils values to our server_coils
-	for (int i = 0; i < quantity; i++)
-	{
-		nmbs_bitfield_write(server_coils, address + i, nmbs_bitfield_read(coils, i));
-	}
-
+	/*coils follow the sensor, a write is accepted and has no effect*/
 	return NMBS_ERROR_NONE;
 }
 
 static nmbs_error handler_read_holding_registers(uint16_t address, uint16_t quantity, uint16_t *registers_out, uint8_t unit_id,
 		void *arg)
 {
+	if (address >= LG_MODBUS_CHG_BASE_ADDR)
+		return handle_read_changes(address, quantity, registers_out);
+
+	if (address >= LG_MODBUS_HIST_BASE_ADDR)
+		return handle_read_history(address, quantity, registers_out);
+
+	if (address >= LG_MODBUS_CONF_BASE_ADDR)
+		return handle_read_conf(address, quantity, registers_out);
+
+	if (address >= LG_MODBUS_FAST_BASE_ADDR)
+		return handle_read_fast(address, quantity, registers_out);
+
+	if (address >= LG_MODBUS_CHAIN_BASE_ADDR)
+		return handle_read_chain(address, quantity, registers_out);
+
+	if (address >= LG_MODBUS_BAUD_BASE_ADDR)
+		return handle_read_baud(address, quantity, registers_out);
+
+	if (address >= LG_MODBUS_SYNC_BASE_ADDR)
+		return handle_read_sync(address, quantity, registers_out);
+
 	if (address + quantity > LB_MODBUS_ADDR_MAX + 1)
 		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
 
-	// update current data
-	modbus_server_update();
-	// Read our registers values into registers_out
+	/*scan path: a single DI_VALUE read is one halfword load*/
+	if (address == DI_VALUE_ADDR && quantity == 1)
+	{
+		registers_out[0] = lg_module_sensor_value_get();
+		return NMBS_ERROR_NONE;
+	}
+
 	for (int i = 0; i < quantity; i++)
-		registers_out[i] = server_registers[address + i];
+		registers_out[i] = modbus_register_get(address + i);
 
 	return NMBS_ERROR_NONE;
 }
@@ -226,10 +466,57 @@ static nmbs_error handle_write_multiple_registers(uint16_t address, uint16_t qua
 {
 	nmbs_error err = NMBS_ERROR_NONE;
 
+	if (address == LG_MODBUS_HIST_SINCE_ADDR && quantity == 1)
+	{
+		/*volatile read pointer, not stored in flash*/
+		history_since = registers[0];
+		return NMBS_ERROR_NONE;
+	}
+
+	if (address == LG_MODBUS_CHG_SINCE_ADDR && quantity == 1)
+	{
+		/*volatile read pointer, not stored in flash*/
+		changes_since = registers[0];
+		return NMBS_ERROR_NONE;
+	}
+
+	if (address >= LG_MODBUS_BAUD_BASE_ADDR && address < LG_MODBUS_BAUD_BASE_ADDR + LG_MODBUS_BAUD_REGS)
+		return handle_write_baud(address, quantity, registers);
+
+	if (address >= LG_MODBUS_CHAIN_BASE_ADDR && address < LG_MODBUS_CHAIN_BASE_ADDR + LG_MODBUS_CHAIN_REGS)
+		return handle_write_chain(address, quantity, registers);
+
+	if (address >= LG_MODBUS_FAST_BASE_ADDR && address < LG_MODBUS_FAST_BASE_ADDR + LG_MODBUS_FAST_REGS)
+		return handle_write_fast(address, quantity, registers);
+
+	if (address >= LG_MODBUS_CONF_BASE_ADDR && address < LG_MODBUS_CONF_BASE_ADDR + LG_MODBUS_CONF_REGS)
+		return handle_write_conf(address, quantity, registers);
+
+	if (address == LG_MODBUS_DIAG_RESET_ADDR && quantity == 1)
+	{
+		if (registers[0] != 1U)
+			return NMBS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+		lg_module_sensor_diag_reset();
+		__disable_irq();
+		diag.latency_max_us = 0;
+		__enable_irq();
+		return NMBS_ERROR_NONE;
+	}
+
+	if (address == LG_MODBUS_SYNC_ID_ADDR && quantity == 1)
+	{
+		/*addressed sync, the broadcast one is latched from the rx isr*/
+		__disable_irq();
+		lg_module_sensor_sync(registers[0]);
+		__enable_irq();
+		return NMBS_ERROR_NONE;
+	}
+
 	if (address + quantity > LB_MODBUS_ADDR_MAX + 1)
 		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
 
-	// Write registers values to our server_registers
+	// Write registers values to the configuration
 	for (int i = 0; i < quantity; i++)
 	{
 		if (modbus_tcp_write_data(address + i, registers[i]) != NMBS_ERROR_NONE)
@@ -239,7 +526,7 @@ static nmbs_error handle_write_multiple_registers(uint16_t address, uint16_t qua
 		}
 	}
 
-	modbus_server_update();
+	modbus_conf_update();
 
 	return err;
 }
@@ -250,55 +537,866 @@ static nmbs_error handle_write_single_register(uint16_t address, uint16_t value,
 	return handle_write_multiple_registers(address, 1, &value, unit_id, arg);
 }
 
-static void modbus_server_update(void)
+/**
+ * @brief microseconds since boot, derived from systick
+ */
+static uint32_t lg_module_time_us(void)
 {
-	LG_CONF_TypeDef_t conf = {0};
-	LG_SENSOR_TypeDef_t sensor = {0};
-	/*get current data */
-	lg_module_eeprom_conf_get(&conf);
+	uint32_t load = SysTick->LOAD + 1U;
+	uint32_t ms;
+	uint32_t val;
+	uint32_t pend;
+
+	do
+	{
+		ms = HAL_GetTick();
+		val = SysTick->VAL;
+		pend = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+	} while (ms != HAL_GetTick());
 
-	lg_module_sensor_get(&sensor);
-	/*update register -----------------------------------------------------*/
-	memset(server_registers, 0, LB_MODBUS_ADDR_MAX);
-	/*conf data**/
-	for (uint8_t i = OFFSET_S1_ADDR; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+	/*systick reloaded but its isr did not run yet (called with irq masked)*/
+	if (pend && val > (load / 2U))
 	{
-		server_registers[i] = (uint16_t)conf.offset[i];
+		ms++;
 	}
-	server_registers[SERVER_ADDR] = conf.address;
-	server_registers[FILTER_FC_ADDR] = (uint16_t)(conf.fc * 10);
-	server_registers[SENSOR_THRESHOLD_ADDR] = conf.threshold;
-	/*sensor filtered data*/
-	for (uint8_t i = S1_ADDR; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+
+	return (ms * 1000U) + (((load - val) * 1000U) / load);
+}
+
+/**
+ * @brief check the crc of a received frame
+ * @return 1 if the frame is a complete rtu frame, 0 otherwise
+ */
+static uint8_t lg_module_frame_valid(const uint8_t *buf, uint16_t len)
+{
+	uint16_t crc;
+
+	if (len < 4)
 	{
-		server_registers[i] = sensor.S[i - S1_ADDR];
+		return 0;
 	}
-	/*sensor adc value*/
-	for (uint8_t i = A1_ADDR; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+
+	crc = checksum_nmbs_crc16(buf, len - 2, NULL);
+
+	return (buf[len - 2] == (uint8_t)(crc >> 8) && buf[len - 1] == (uint8_t)crc) ? 1 : 0;
+}
+
+/**
+ * @brief rtu inter-frame gap (t3.5) at the current rate, fixed 1.75 ms above 19200
+ */
+static uint32_t lg_module_t35_us(void)
+{
+	uint32_t rate = huart1.Init.BaudRate;
+
+	return (rate > 19200U) ? 1750U : (35000000U / rate);
+}
+
+/**
+ * @brief start a dma reception that ends on the receiver timeout (t3.5)
+ */
+static void lg_module_rx_start(void)
+{
+	HAL_UART_Receive_DMA(&huart1, rx_buffer, LG_UART_RX_BUFFER_SIZE);
+}
+
+/**
+ * @brief complete frame received (receiver timeout), called from the uart isr
+ */
+static void lg_module_rx_frame(uint16_t size)
+{
+	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
+	diag.rx_end_us = lg_module_time_us();
+	diag.frames++;
+	/*fast scan frames are shorter than any rtu frame*/
+	if (lg_module_fast_frame(rx_buffer, size))
 	{
-		server_registers[i] = sensor.raw[i - A1_ADDR];
+		return;
 	}
-	/*offset apply data*/
-	for (uint8_t i = D1_ADDR; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+	/*bus activity at our rate*/
+	if (lg_module_frame_valid(rx_buffer, size))
+	{
+		baud.garbage = 0;
+	}
+	else
+	{
+		lg_module_baud_garbage();
+		diag.crc_errors++;
+	}
+	/*scan read of DI_VALUE, the reply is already built*/
+	if (lg_module_di_frame(rx_buffer, size))
 	{
-		server_registers[i] = sensor.D[i - D1_ADDR];
+		return;
 	}
-	server_registers[DI_VALUE_ADDR] = sensor.value;
+	/*sync and snapshot traffic is handled from here, anything else goes to nanoMODBUS*/
+	if (lg_module_sync_frame(rx_buffer, size) == 0 && lg_module_snapshot_frame(rx_buffer, size) == 0)
+	{
+		/*write to ring buffer, the main loop wakes up on the count*/
+		lwrb_write(&rb, rx_buffer, size);
+		rx_frames++;
+	}
+}
 
-	/*update cooils*/
-	for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+/**
+ * @brief reconfigure uart1 and the nanoMODBUS timeouts for a rate code
+ */
+static void lg_module_baud_apply(uint8_t code)
+{
+	uint32_t rate = baud_rates[code];
+	/*long frames reach nanoMODBUS one dma buffer at a time*/
+	uint32_t chunk_ms = (LG_UART_RX_BUFFER_SIZE * 10U * 1000U + rate - 1U) / rate;
+
+	HAL_UART_AbortReceive(&huart1);
+
+	huart1.Init.BaudRate = rate;
+	HAL_UART_Init(&huart1);
+
+	/*end of frame from the receiver timeout: t3.5 in bit times (10 bit characters)*/
+	HAL_UART_ReceiverTimeout_Config(&huart1, (rate > 19200U) ? ((rate / 1000U) * 1750U) / 1000U : 35U);
+	HAL_UART_EnableReceiverTimeout(&huart1);
+
+	/*bytes received at the old rate are meaningless*/
+	lwrb_reset(&rb);
+	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
+	lg_module_rx_start();
+
+	nmbs_set_byte_timeout(&nmbs, (int32_t)(chunk_ms + (lg_module_t35_us() + 999U) / 1000U + 1U));
+
+	baud.code = code;
+	baud.garbage = 0;
+}
+
+/**
+ * @brief count an invalid frame (saturating)
+ */
+static void lg_module_baud_garbage(void)
+{
+	if (baud.garbage < UINT8_MAX)
+	{
+		baud.garbage++;
+	}
+}
+
+/**
+ * @brief scheduled switch, trial revert and garbage fallback
+ */
+static void lg_module_baud_poll(void)
+{
+	uint32_t now = HAL_GetTick();
+
+	if (baud.next < LG_BAUD_MAX)
+	{
+		/*wait for the switch point and for our own reply to leave*/
+		if ((int32_t)(now - baud.switch_tick) < 0 || huart1.gState != HAL_UART_STATE_READY)
+		{
+			return;
+		}
+
+		baud.prev = baud.code;
+		baud.trial = 1;
+		baud.trial_tick = now;
+		lg_module_baud_apply(baud.next);
+		baud.next = LG_BAUD_MAX;
+		return;
+	}
+
+	if (baud.trial)
+	{
+		/*no commit, the controller gave up on this rate*/
+		if ((now - baud.trial_tick) >= LG_BAUD_TRIAL_MS)
+		{
+			baud.trial = 0;
+			lg_module_baud_apply(baud.prev);
+		}
+		return;
+	}
+
+	/*a silent bus is an idle controller, only garbage moves the rate*/
+	if (baud.code != baud.stored && baud.garbage)
+	{
+		/*on the fallback rate and the bus talks at another one*/
+		lg_module_baud_apply(baud.stored);
+	}
+	else if (baud.code != LG_BAUD_9600 && baud.garbage >= LG_BAUD_GARBAGE_MIN)
+	{
+		/*frames keep failing at the stored rate: try the boot rate*/
+		lg_module_baud_apply(LG_BAUD_9600);
+	}
+}
+
+/**
+ * @brief store the staged configuration once the writes stop
+ */
+static void lg_module_conf_poll(void)
+{
+	if (lg_module_eeprom_dirty() && (HAL_GetTick() - conf_tick) >= LG_CONF_COMMIT_IDLE_MS)
 	{
-		if (sensor.value & (1 << i))
+		/*a failed write is retried after another idle period*/
+		conf_tick = HAL_GetTick();
+		lg_module_eeprom_commit();
+	}
+}
+
+/**
+ * @brief count a reply to the request that ended at diag.rx_end_us
+ */
+static void lg_module_diag_reply(void)
+{
+	uint32_t latency = lg_module_time_us() - diag.rx_end_us;
+
+	diag.replies++;
+	diag.latency_us = (latency > UINT16_MAX) ? UINT16_MAX : (uint16_t)latency;
+	if (diag.latency_us > diag.latency_max_us)
+	{
+		diag.latency_max_us = diag.latency_us;
+	}
+}
+
+/**
+ * @brief integer square root (floor), main loop only
+ */
+static uint16_t lg_module_isqrt(uint64_t value)
+{
+	uint64_t root = 0;
+	uint64_t bit = (uint64_t)1 << 62;
+
+	while (bit > value)
+	{
+		bit >>= 2;
+	}
+	while (bit != 0)
+	{
+		if (value >= root + bit)
 		{
-			nmbs_bitfield_set(server_coils, i);
+			value -= root + bit;
+			root = (root >> 1) + bit;
 		}
 		else
 		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (root > UINT16_MAX) ? UINT16_MAX : (uint16_t)root;
+}
+
+/**
+ * @brief latch a broadcast sync frame from the rx isr
+ * @return 1 if the frame is a broadcast write to SYNC_ID, 0 otherwise
+ */
+static uint8_t lg_module_sync_frame(const uint8_t *buf, uint16_t len)
+{
+	uint16_t crc;
+
+	if (len != LG_MODBUS_SYNC_FRAME_LEN || buf[0] != NMBS_BROADCAST_ADDRESS || buf[1] != 0x06 ||
+		buf[2] != (uint8_t)(LG_MODBUS_SYNC_ID_ADDR >> 8) || buf[3] != (uint8_t)LG_MODBUS_SYNC_ID_ADDR)
+	{
+		return 0;
+	}
+
+	crc = checksum_nmbs_crc16(buf, len - 2, NULL);
+	if (buf[len - 2] == (uint8_t)(crc >> 8) && buf[len - 1] == (uint8_t)crc)
+	{
+		/*latch here, not in the main loop: no poll jitter between sensors*/
+		lg_module_sensor_sync(((uint16_t)buf[4] << 8) | buf[5]);
+	}
+
+	/*broadcast has no reply, nothing left for nanoMODBUS*/
+	return 1;
+}
+
+/**
+ * @brief handle snapshot traffic from the rx isr
+ * @return 1 if the frame belongs to the snapshot protocol, 0 otherwise
+ */
+static uint8_t lg_module_snapshot_frame(const uint8_t *buf, uint16_t len)
+{
+	uint16_t crc;
+	uint16_t value;
+	uint16_t seq;
+	uint8_t own = nmbs.address_rtu;
+
+	if (len < LG_MODBUS_SNAPSHOT_REQ_LEN || (buf[1] != LG_MODBUS_FC_SNAPSHOT && buf[1] != LG_MODBUS_FC_LATCH))
+	{
+		return 0;
+	}
+
+	crc = checksum_nmbs_crc16(buf, len - 2, NULL);
+	if (buf[len - 2] != (uint8_t)(crc >> 8) || buf[len - 1] != (uint8_t)crc)
+	{
+		/*corrupted snapshot traffic, drop it*/
+		return 1;
+	}
+
+	if (buf[0] == NMBS_BROADCAST_ADDRESS && len == LG_MODBUS_SNAPSHOT_REQ_LEN)
+	{
+		/*latch now, all sensors see this frame at the same time*/
+		seq = ((uint16_t)buf[2] << 8) | buf[3];
+		lg_module_sensor_latch(seq);
+		snapshot.last_seq = seq;
 
-			nmbs_bitfield_unset(server_coils, i);
+		if (buf[1] == LG_MODBUS_FC_LATCH)
+		{
+			return 1;
 		}
+
+		value = lg_module_sensor_value_get();
+
+		snapshot.seq = (uint8_t)seq;
+		snapshot.frame[0] = own;
+		snapshot.frame[1] = LG_MODBUS_FC_SNAPSHOT;
+		snapshot.frame[2] = snapshot.seq;
+		snapshot.frame[3] = (uint8_t)(value >> 8);
+		snapshot.frame[4] = (uint8_t)value;
+		crc = checksum_nmbs_crc16(snapshot.frame, LG_MODBUS_SNAPSHOT_RSP_LEN - 2, NULL);
+		snapshot.frame[5] = (uint8_t)(crc >> 8);
+		snapshot.frame[6] = (uint8_t)crc;
+
+		lg_module_chain_start(LG_MODBUS_SNAPSHOT_RSP_LEN);
 	}
-	return;
+	else if (len == LG_MODBUS_SNAPSHOT_RSP_LEN && buf[1] == LG_MODBUS_FC_SNAPSHOT && snapshot.pending &&
+			 snapshot.len == LG_MODBUS_SNAPSHOT_RSP_LEN && buf[2] == snapshot.seq)
+	{
+		/*reply of a previous sensor in the chain*/
+		lg_module_chain_heard(buf[0]);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief answer the FC03 DI_VALUE request from the rx isr with the prebuilt reply
+ * @return 1 if the reply is on its way, 0 to hand the frame to nanoMODBUS
+ */
+static uint8_t lg_module_di_frame(const uint8_t *buf, uint16_t len)
+{
+	if (len != LG_MODBUS_DI_REQ_LEN || memcmp(buf, di_request, LG_MODBUS_DI_REQ_LEN) != 0 ||
+		huart1.gState != HAL_UART_STATE_READY)
+	{
+		return 0;
+	}
+
+	memcpy(di_tx, di_reply, LG_MODBUS_DI_RSP_LEN);
+
+	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_SET);
+	if (HAL_UART_Transmit_IT(&huart1, di_tx, LG_MODBUS_DI_RSP_LEN) != HAL_OK)
+	{
+		HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
+		return 0;
+	}
+	lg_module_diag_reply();
+
+	return 1;
+}
+
+/**
+ * @brief rebuild the DI_VALUE request and reply for a server address
+ */
+static void lg_module_di_build(uint8_t addr)
+{
+	uint16_t crc;
+
+	/*the rx and adc isr read both frames*/
+	__disable_irq();
+	di_request[0] = addr;
+	di_request[1] = 0x03;
+	di_request[2] = (uint8_t)(DI_VALUE_ADDR >> 8);
+	di_request[3] = (uint8_t)DI_VALUE_ADDR;
+	di_request[4] = 0x00;
+	di_request[5] = 0x01;
+	crc = checksum_crc16(di_request, LG_MODBUS_DI_REQ_LEN - 2);
+	di_request[6] = (uint8_t)crc;
+	di_request[7] = (uint8_t)(crc >> 8);
+
+	di_reply[0] = addr;
+	di_reply[1] = 0x03;
+	di_reply[2] = 0x02;
+	di_crc = checksum_crc16(di_reply, 3);
+
+	lg_module_di_update(lg_module_sensor_value_get());
+	__enable_irq();
+}
+
+/**
+ * @brief refresh value and crc of the DI_VALUE reply, called from the adc isr
+ */
+static void lg_module_di_update(uint16_t value)
+{
+	uint16_t crc;
+
+	di_reply[3] = (uint8_t)(value >> 8);
+	di_reply[4] = (uint8_t)value;
+	/*only the two value bytes go through the table*/
+	crc = checksum_crc16_update(di_crc, &di_reply[3], 2);
+	di_reply[5] = (uint8_t)crc;
+	di_reply[6] = (uint8_t)(crc >> 8);
+}
+
+/**
+ * @brief handle fast scan traffic from the rx isr
+ * @return 1 if the frame belongs to the fast scan protocol, 0 otherwise
+ */
+static uint8_t lg_module_fast_frame(const uint8_t *buf, uint16_t len)
+{
+	uint8_t check[LG_MODBUS_FAST_RSP_LEN];
+	uint16_t value;
+	uint8_t own = nmbs.address_rtu;
+	uint8_t step;
+
+	if (snapshot.fast == 0 || (len != LG_MODBUS_FAST_REQ_LEN && len != LG_MODBUS_FAST_RSP_LEN))
+	{
+		return 0;
+	}
+
+	if (len == LG_MODBUS_FAST_REQ_LEN)
+	{
+		/*poll token: low byte of seq, a few steps after the last latch*/
+		step = (uint8_t)(buf[0] - (uint8_t)snapshot.last_seq);
+		if ((step == 0 || step > LG_MODBUS_FAST_SEQ_WINDOW) && snapshot.fast_sync == 0)
+		{
+			/*noise byte or a token we already took: no latch, no reply*/
+			return 1;
+		}
+		snapshot.fast_sync = 0;
+		snapshot.last_seq += step;
+		lg_module_sensor_latch(snapshot.last_seq);
+
+		if (own > LG_MODBUS_FAST_ADDR_MAX)
+		{
+			return 1;
+		}
+
+		value = lg_module_sensor_value_get();
+
+		snapshot.seq = buf[0];
+		snapshot.frame[0] = (uint8_t)((own << 2) | ((value >> 8) & 0x03U));
+		snapshot.frame[1] = (uint8_t)value;
+		check[0] = snapshot.seq;
+		check[1] = snapshot.frame[0];
+		check[2] = snapshot.frame[1];
+		snapshot.frame[2] = checksum_crc8(check, LG_MODBUS_FAST_RSP_LEN);
+
+		lg_module_chain_start(LG_MODBUS_FAST_RSP_LEN);
+		return 1;
+	}
+
+	/*reply of another sensor, only valid for the current token*/
+	check[0] = snapshot.seq;
+	check[1] = buf[0];
+	check[2] = buf[1];
+	if (checksum_crc8(check, LG_MODBUS_FAST_RSP_LEN) != buf[2])
+	{
+		lg_module_baud_garbage();
+		return 1;
+	}
+
+	baud.garbage = 0;
+	if (snapshot.pending && snapshot.len == LG_MODBUS_FAST_RSP_LEN)
+	{
+		lg_module_chain_heard(buf[0] >> 2);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief queue the latched reply: answer first in the chain or arm the fallback slot
+ */
+static void lg_module_chain_start(uint8_t len)
+{
+	uint8_t own = nmbs.address_rtu;
+	/*predecessor and position on the segment, address order by default*/
+	uint8_t prev = snapshot.chained ? snapshot.prev : own - 1U;
+	uint8_t slot = snapshot.chained ? snapshot.slot : own - 1U;
+
+	snapshot.len = len;
+	snapshot.pending = 1;
+	if (prev == 0)
+	{
+		lg_module_snapshot_send();
+	}
+	else
+	{
+		snapshot.deadline_us = lg_module_time_us() + slot * lg_module_chain_slot_us();
+	}
+}
+
+/**
+ * @brief reply of another sensor heard while ours is pending
+ */
+static void lg_module_chain_heard(uint8_t addr)
+{
+	uint8_t own = nmbs.address_rtu;
+	uint8_t prev = snapshot.chained ? snapshot.prev : own - 1U;
+
+	if (addr == prev)
+	{
+		lg_module_snapshot_send();
+	}
+	else if (!snapshot.chained && addr < own)
+	{
+		/*someone in between is silent, keep one slot for each*/
+		snapshot.deadline_us = lg_module_time_us() + (own - 1U - addr) * lg_module_chain_slot_us();
+	}
+}
+
+/**
+ * @brief time on the wire of one reply + t3.5 + guard
+ */
+static uint32_t lg_module_chain_slot_us(void)
+{
+	return ((snapshot.len * 10U * 1000000U) / huart1.Init.BaudRate) + lg_module_t35_us() + LG_SNAPSHOT_GUARD_US;
+}
+
+/**
+ * @brief start transmission of the latched snapshot reply
+ */
+static void lg_module_snapshot_send(void)
+{
+	snapshot.pending = 0;
+
+	HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_SET);
+
+	if (HAL_UART_Transmit_IT(&huart1, snapshot.frame, snapshot.len) != HAL_OK)
+	{
+		HAL_GPIO_WritePin(DIR_GPIO_Port, DIR_Pin, GPIO_PIN_RESET);
+		return;
+	}
+	/*chained reply: its delay is the slot, not a latency*/
+	diag.replies++;
+}
+
+/**
+ * @brief send the snapshot reply when its fallback slot arrives
+ */
+static void lg_module_snapshot_poll(void)
+{
+	if (snapshot.pending == 0)
+	{
+		return;
+	}
+
+	__disable_irq();
+	if (snapshot.pending && (int32_t)(lg_module_time_us() - snapshot.deadline_us) >= 0)
+	{
+		lg_module_snapshot_send();
+	}
+	__enable_irq();
+}
+
+static nmbs_error handle_read_history(uint16_t address, uint16_t quantity, uint16_t *registers_out)
+{
+	uint16_t newest;
+	uint16_t count;
+
+	if (address != LG_MODBUS_HIST_BASE_ADDR || quantity < 2 || quantity > LG_MODBUS_HIST_REGS_MAX)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	count = lg_module_sensor_history_get(history_since, history_slices, (quantity - 2) / 3, &newest);
+
+	memset(registers_out, 0, quantity * sizeof(uint16_t));
+	registers_out[0] = newest;
+	registers_out[1] = count;
+	for (uint16_t i = 0; i < count; i++)
+	{
+		registers_out[2 + 3 * i] = history_slices[i].seq;
+		registers_out[3 + 3 * i] = history_slices[i].value;
+		registers_out[4 + 3 * i] = history_slices[i].tick;
+	}
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_read_changes(uint16_t address, uint16_t quantity, uint16_t *registers_out)
+{
+	LG_CHANGES_TypeDef_t info;
+	uint16_t count;
+
+	if (address != LG_MODBUS_CHG_BASE_ADDR || quantity < LG_MODBUS_CHG_REGS_MIN || quantity > LG_MODBUS_CHG_REGS_MAX)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	count = lg_module_sensor_changes_get(changes_since, changes_entries, (quantity - 3) / 2, &info);
+
+	memset(registers_out, 0, quantity * sizeof(uint16_t));
+	registers_out[0] = info.head;
+	registers_out[1] = count | (info.lost ? LG_MODBUS_CHG_LOST : 0) | (info.more ? LG_MODBUS_CHG_MORE : 0);
+	registers_out[2] = info.base;
+	for (uint16_t i = 0; i < count; i++)
+	{
+		registers_out[3 + 2 * i] = changes_entries[i].seq;
+		registers_out[4 + 2 * i] = changes_entries[i].value;
+	}
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_read_sync(uint16_t address, uint16_t quantity, uint16_t *registers_out)
+{
+	LG_SYNC_TypeDef_t latched;
+	uint16_t regs[LG_MODBUS_SYNC_REGS];
+
+	if (address + quantity > LG_MODBUS_SYNC_BASE_ADDR + LG_MODBUS_SYNC_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	lg_module_sensor_sync_get(&latched);
+
+	regs[LG_MODBUS_SYNC_ID_ADDR - LG_MODBUS_SYNC_BASE_ADDR] = latched.id;
+	regs[LG_MODBUS_SYNC_VALUE_ADDR - LG_MODBUS_SYNC_BASE_ADDR] = latched.value;
+	for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+	{
+		regs[LG_MODBUS_SYNC_D1_ADDR - LG_MODBUS_SYNC_BASE_ADDR + i] = latched.D[i];
+	}
+
+	memcpy(registers_out, &regs[address - LG_MODBUS_SYNC_BASE_ADDR], quantity * sizeof(uint16_t));
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_read_baud(uint16_t address, uint16_t quantity, uint16_t *registers_out)
+{
+	uint16_t regs[LG_MODBUS_BAUD_REGS];
+
+	if (address + quantity > LG_MODBUS_BAUD_BASE_ADDR + LG_MODBUS_BAUD_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	regs[LG_MODBUS_BAUD_CODE_ADDR - LG_MODBUS_BAUD_BASE_ADDR] = baud.code;
+	regs[LG_MODBUS_BAUD_DELAY_ADDR - LG_MODBUS_BAUD_BASE_ADDR] = 0;
+	regs[LG_MODBUS_BAUD_COMMIT_ADDR - LG_MODBUS_BAUD_BASE_ADDR] = baud.stored;
+
+	memcpy(registers_out, &regs[address - LG_MODBUS_BAUD_BASE_ADDR], quantity * sizeof(uint16_t));
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_write_baud(uint16_t address, uint16_t quantity, const uint16_t *registers)
+{
+	LG_CONF_TypeDef_t conf = {0};
+
+	if (address == LG_MODBUS_BAUD_CODE_ADDR && quantity == 2)
+	{
+		if (registers[0] >= LG_BAUD_MAX)
+			return NMBS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+		/*switch after the delay, a unicast reply still leaves at the old rate*/
+		baud.switch_tick = HAL_GetTick() + registers[1];
+		baud.next = (uint8_t)registers[0];
+		return NMBS_ERROR_NONE;
+	}
+
+	if (address == LG_MODBUS_BAUD_COMMIT_ADDR && quantity == 1)
+	{
+		if (registers[0] != baud.code)
+			return NMBS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+		baud.trial = 0;
+		if (baud.stored != baud.code)
+		{
+			baud.stored = baud.code;
+			lg_module_eeprom_conf_get(&conf);
+			conf.baud = baud.code;
+			lg_module_eeprom_conf_set(&conf);
+		}
+		return NMBS_ERROR_NONE;
+	}
+
+	return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+}
+
+static nmbs_error handle_read_chain(uint16_t address, uint16_t quantity, uint16_t *registers_out)
+{
+	uint8_t own = nmbs.address_rtu;
+	uint16_t regs[LG_MODBUS_CHAIN_REGS];
+
+	if (address + quantity > LG_MODBUS_CHAIN_BASE_ADDR + LG_MODBUS_CHAIN_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	regs[LG_MODBUS_CHAIN_PREV_ADDR - LG_MODBUS_CHAIN_BASE_ADDR] = snapshot.chained ? snapshot.prev : own - 1U;
+	regs[LG_MODBUS_CHAIN_SLOT_ADDR - LG_MODBUS_CHAIN_BASE_ADDR] = snapshot.chained ? snapshot.slot : own - 1U;
+
+	memcpy(registers_out, &regs[address - LG_MODBUS_CHAIN_BASE_ADDR], quantity * sizeof(uint16_t));
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_write_chain(uint16_t address, uint16_t quantity, const uint16_t *registers)
+{
+	if (address != LG_MODBUS_CHAIN_PREV_ADDR || quantity != LG_MODBUS_CHAIN_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	if (registers[0] > 247U || registers[1] > UINT8_MAX)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+	/*the rx isr reads the chain*/
+	__disable_irq();
+	snapshot.prev = (uint8_t)registers[0];
+	snapshot.slot = (uint8_t)registers[1];
+	snapshot.chained = 1;
+	__enable_irq();
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_read_fast(uint16_t address, uint16_t quantity, uint16_t *registers_out)
+{
+	if (address + quantity > LG_MODBUS_FAST_BASE_ADDR + LG_MODBUS_FAST_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	registers_out[0] = snapshot.fast;
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_write_fast(uint16_t address, uint16_t quantity, const uint16_t *registers)
+{
+	if (address != LG_MODBUS_FAST_ENABLE_ADDR || quantity != LG_MODBUS_FAST_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	if (registers[0] > 1U)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+	/*ram only: a rebooted sensor is back on plain modbus*/
+	snapshot.fast = (uint8_t)registers[0];
+	snapshot.fast_sync = snapshot.fast;
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_read_input_registers(uint16_t address, uint16_t quantity, uint16_t *registers_out, uint8_t unit_id,
+		void *arg)
+{
+	LG_DIAG_TypeDef_t sensor_diag;
+	uint16_t regs[LG_MODBUS_DIAG_REGS] = {0};
+	uint16_t *noise = &regs[LG_MODBUS_DIAG_NOISE_ADDR];
+
+	if (address + quantity > LG_MODBUS_DIAG_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	lg_module_sensor_diag_get(&sensor_diag);
+
+	regs[LG_MODBUS_DIAG_ISR_LAST_ADDR] = sensor_diag.isr_last;
+	regs[LG_MODBUS_DIAG_ISR_MIN_ADDR] = sensor_diag.isr_min;
+	regs[LG_MODBUS_DIAG_ISR_MAX_ADDR] = sensor_diag.isr_max;
+	regs[LG_MODBUS_DIAG_CORE_MHZ_ADDR] = (uint16_t)(SystemCoreClock / 1000000U);
+	regs[LG_MODBUS_DIAG_BLOCKS_ADDR] = sensor_diag.blocks;
+
+	__disable_irq();
+	regs[LG_MODBUS_DIAG_FRAMES_ADDR] = diag.frames;
+	regs[LG_MODBUS_DIAG_CRC_ERRORS_ADDR] = diag.crc_errors;
+	regs[LG_MODBUS_DIAG_REPLIES_ADDR] = diag.replies;
+	regs[LG_MODBUS_DIAG_LATENCY_ADDR] = diag.latency_us;
+	regs[LG_MODBUS_DIAG_LATENCY_MAX_ADDR] = diag.latency_max_us;
+	regs[LG_MODBUS_DIAG_LINE_ERRORS_ADDR] = diag.line_errors;
+	__enable_irq();
+
+	for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+	{
+		noise[0] = (uint16_t)sensor_diag.noise[i].min;
+		noise[1] = (uint16_t)sensor_diag.noise[i].max;
+		/*rms in 1/16 adc counts: sqrt(ms * 256), ms = ms_acc / 2^shift*/
+		noise[2] = lg_module_isqrt(((uint64_t)sensor_diag.noise[i].ms_acc << 8) >> LG_SENSOR_NOISE_SHIFT);
+		noise += LG_MODBUS_DIAG_NOISE_STRIDE;
+	}
+
+	memcpy(registers_out, &regs[address], quantity * sizeof(uint16_t));
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_read_conf(uint16_t address, uint16_t quantity, uint16_t *registers_out)
+{
+	if (address + quantity > LG_MODBUS_CONF_BASE_ADDR + LG_MODBUS_CONF_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	LG_CONF_TypeDef_t conf = {0};
+	uint16_t regs[LG_MODBUS_CONF_REGS];
+
+	lg_module_eeprom_conf_get(&conf);
+	regs[0] = lg_module_eeprom_dirty();
+	regs[1] = conf.ovs_ratio;
+	regs[2] = conf.ovs_shift;
+
+	memcpy(registers_out, &regs[address - LG_MODBUS_CONF_BASE_ADDR], quantity * sizeof(uint16_t));
+
+	return NMBS_ERROR_NONE;
+}
+
+static nmbs_error handle_write_conf(uint16_t address, uint16_t quantity, const uint16_t *registers)
+{
+	LG_CONF_TypeDef_t conf = {0};
+	uint16_t end = address + quantity;
+	uint16_t ovs[2];
+
+	if (end > LG_MODBUS_CONF_BASE_ADDR + LG_MODBUS_CONF_REGS)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+	if (address == LG_MODBUS_CONF_COMMIT_ADDR && registers[0] != 1U)
+		return NMBS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+	/*oversampling pair, a register not written keeps its value*/
+	if (end > LG_MODBUS_CONF_OVS_RATIO_ADDR)
+	{
+		lg_module_eeprom_conf_get(&conf);
+		ovs[0] = conf.ovs_ratio;
+		ovs[1] = conf.ovs_shift;
+		for (uint16_t a = (address > LG_MODBUS_CONF_OVS_RATIO_ADDR) ? address : LG_MODBUS_CONF_OVS_RATIO_ADDR; a < end; a++)
+			ovs[a - LG_MODBUS_CONF_OVS_RATIO_ADDR] = registers[a - address];
+
+		/*restarts the acquisition with the new ratio*/
+		if (ovs[0] > UINT8_MAX || ovs[1] > UINT8_MAX ||
+			lg_module_sensor_oversampling_set((uint8_t)ovs[0], (uint8_t)ovs[1]) != 0)
+			return NMBS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+		conf.ovs_ratio = (uint8_t)ovs[0];
+		conf.ovs_shift = (uint8_t)ovs[1];
+		lg_module_eeprom_conf_stage(&conf);
+		conf_tick = HAL_GetTick();
+	}
+
+	if (address == LG_MODBUS_CONF_COMMIT_ADDR && lg_module_eeprom_commit() != 0)
+		return NMBS_EXCEPTION_SERVER_DEVICE_FAILURE;
+
+	return NMBS_ERROR_NONE;
+}
+
+static void modbus_conf_update(void)
+{
+	LG_CONF_TypeDef_t conf = {0};
+
+	lg_module_eeprom_conf_get(&conf);
+	/*float to integer conversions done once per write, not once per read*/
+	for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+	{
+		conf_registers[OFFSET_S1_ADDR + i] = (uint16_t)conf.offset[i];
+	}
+	conf_registers[SERVER_ADDR] = conf.address;
+	conf_registers[FILTER_FC_ADDR] = (uint16_t)(conf.fc * 10);
+	conf_registers[SENSOR_THRESHOLD_ADDR] = conf.threshold;
+}
+
+static uint16_t modbus_register_get(uint16_t address)
+{
+	const volatile LG_SENSOR_TypeDef_t *sensor = lg_module_sensor_ref();
+
+	if (address < FACTORY_RESET_ADDR)
+		return conf_registers[address];
+
+	/*sensor filtered data*/
+	if (address >= S1_ADDR && address <= S10_ADDR)
+		return sensor->S[address - S1_ADDR];
+
+	/*offset apply data*/
+	if (address >= D1_ADDR && address <= D10_ADDR)
+		return sensor->D[address - D1_ADDR];
+
+	/*sensor adc value*/
+	if (address >= A1_ADDR && address <= A10_ADDR)
+		return sensor->raw[address - A1_ADDR];
+
+	if (address == DI_VALUE_ADDR)
+		return sensor->value;
+
+	/*command registers (factory reset, calibration) read back as 0*/
+	return 0;
 }
 
 nmbs_error modbus_tcp_write_data(uint16_t address, uint16_t val)
@@ -307,6 +1405,7 @@ nmbs_error modbus_tcp_write_data(uint16_t address, uint16_t val)
 	LG_CONF_TypeDef_t conf = {0};
 	nmbs_error err = NMBS_ERROR_NONE;
 	LG_SENSOR_TypeDef_t sensor = {0};
+	uint8_t baud_code;
 	/*get current*/
 	lg_module_eeprom_conf_get(&conf);
 
@@ -364,12 +1463,17 @@ nmbs_error modbus_tcp_write_data(uint16_t address, uint16_t val)
 		}
 		break;
 	case FACTORY_RESET_ADDR:
-
+		/*the bus rate is not a sensor setting: the stored code must keep
+		matching the active one or the sensor comes back off the bus rate*/
+		baud_code = conf.baud;
 		memset(&conf, 0, sizeof(LG_CONF_TypeDef_t));
 
+		conf.baud = baud_code;
 		conf.address = LG_MODBUS_SERVER_DEFAULT_ADDR;
 		conf.fc = LB_FILTER_FC_DEFAULT;
 		conf.threshold = LB_THRESHOLD_DEFAULT;
+		/*back to plain conversions*/
+		lg_module_sensor_oversampling_set(0, 0);
 
 		break;
 
@@ -377,10 +1481,13 @@ nmbs_error modbus_tcp_write_data(uint16_t address, uint16_t val)
 		err = NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
 		break;
 	}
-	/*save data*/
+	/*stage data, flash on CONF_COMMIT or after LG_CONF_COMMIT_IDLE_MS*/
 	if (err != NMBS_EXCEPTION_ILLEGAL_DATA_ADDRESS)
 	{
-		lg_module_eeprom_conf_set(&conf);
+		lg_module_eeprom_conf_stage(&conf);
+		conf_tick = HAL_GetTick();
+		/*offsets and threshold reach the adc isr here*/
+		lg_module_sensor_detect_set(&conf);
 	}
 
 	return err;
@@ -35,7 +35,7 @@ typedef enum lg_module_modbus_addr
     FILTER_FC_ADDR,
     /*umbral data*/
     SENSOR_THRESHOLD_ADDR,
-    /*Factory reset*/
+    /*Factory reset (keeps the bus rate)*/
     FACTORY_RESET_ADDR,
     /*Calibration flag*/
     CALIB_FLAG_ADDR,
@@ -79,6 +79,278 @@ typedef enum lg_module_modbus_addr
     LB_MODBUS_ADDR_MAX,
 } lg_module_modbus_addr_t;
 
+/* ============================================================================
+ * snapshot / latch frames (user defined function codes)
+ * ========================================================================= */
+/*
+ * snapshot request (broadcast): [0x00][0x41][seq hi][seq lo][crc lo][crc hi]
+ * snapshot reply (per sensor) : [addr][0x41][seq lo][value hi][value lo][crc lo][crc hi]
+ * latch request (broadcast)   : [0x00][0x42][seq hi][seq lo][crc lo][crc hi]
+ *
+ * both requests latch DI value into the history ring tagged with seq.
+ * on a snapshot, sensor N answers as soon as it hears the answer of sensor
+ * N-1, or after (N-1) reply slots if it hears nothing. latch has no reply.
+ * the chain block below changes the predecessor and slot per segment.
+ * the fast scan token uses the same chain with shorter frames.
+ */
+#define LG_MODBUS_FC_SNAPSHOT 0x41
+
+#define LG_MODBUS_FC_LATCH 0x42
+
+#define LG_MODBUS_SNAPSHOT_REQ_LEN 6
+
+#define LG_MODBUS_SNAPSHOT_RSP_LEN 7
+
+/* ============================================================================
+ * sync block (FC06 broadcast / FC03)
+ * ========================================================================= */
+/*
+ * SYNC_ID    (W): broadcast [0x00][0x06][0x00][0x80][id hi][id lo][crc lo][crc hi]
+ *                 latches the filtered state tagged with id (and a history slice)
+ * SYNC_ID    (R): id of the latched state
+ * SYNC_VALUE (R): DI value at the sync
+ * SYNC_D1..10(R): offset apply data at the sync
+ */
+#define LG_MODBUS_SYNC_BASE_ADDR 0x0080
+
+#define LG_MODBUS_SYNC_ID_ADDR LG_MODBUS_SYNC_BASE_ADDR
+
+#define LG_MODBUS_SYNC_VALUE_ADDR (LG_MODBUS_SYNC_BASE_ADDR + 1)
+
+#define LG_MODBUS_SYNC_D1_ADDR (LG_MODBUS_SYNC_BASE_ADDR + 2)
+
+#define LG_MODBUS_SYNC_REGS (2 + LG_ADC_SENAOR_MAX_SIZE)
+
+#define LG_MODBUS_SYNC_FRAME_LEN 8
+
+/* ============================================================================
+ * baud rate block (FC03/FC06/FC16)
+ * ========================================================================= */
+/*
+ * BAUD_CODE + BAUD_DELAY (W, FC16, usually broadcast): switch to code
+ *              (LG_BAUD_t) delay ms after the frame. the new rate is on
+ *              trial: without a commit it reverts after LG_BAUD_TRIAL_MS
+ * BAUD_COMMIT (W): value must match the current code, stores it in flash
+ * BAUD_CODE   (R): current code
+ * BAUD_COMMIT (R): stored code
+ * a sensor that gets LG_BAUD_GARBAGE_MIN invalid frames in a row falls back
+ * to 9600, and from there garbage sends it back to the stored rate, so a
+ * controller at either rate can reach it. silence never changes the rate.
+ */
+#define LG_MODBUS_BAUD_BASE_ADDR 0x0090
+
+#define LG_MODBUS_BAUD_CODE_ADDR LG_MODBUS_BAUD_BASE_ADDR
+
+#define LG_MODBUS_BAUD_DELAY_ADDR (LG_MODBUS_BAUD_BASE_ADDR + 1)
+
+#define LG_MODBUS_BAUD_COMMIT_ADDR (LG_MODBUS_BAUD_BASE_ADDR + 2)
+
+#define LG_MODBUS_BAUD_REGS 3
+
+/* ============================================================================
+ * snapshot chain block (FC03/FC16)
+ * ========================================================================= */
+/*
+ * CHAIN_PREV (R/W): address answering right before this sensor on its
+ *                   segment, 0 if it answers first
+ * CHAIN_SLOT (R/W): position on the segment, the fallback reply leaves
+ *                   CHAIN_SLOT reply slots after the request
+ * both live in ram and default to address - 1 (one segment, address order).
+ * the controller writes them after boot when the sensors are split over
+ * several rs-485 segments.
+ */
+#define LG_MODBUS_CHAIN_BASE_ADDR 0x00A0
+
+#define LG_MODBUS_CHAIN_PREV_ADDR LG_MODBUS_CHAIN_BASE_ADDR
+
+#define LG_MODBUS_CHAIN_SLOT_ADDR (LG_MODBUS_CHAIN_BASE_ADDR + 1)
+
+#define LG_MODBUS_CHAIN_REGS 2
+
+/* ============================================================================
+ * fast scan (1 byte poll token, coexists with modbus)
+ * ========================================================================= */
+/*
+ * FAST_ENABLE (R/W, FC03/FC06/FC16, usually broadcast): 1 answers poll tokens, ram only
+ * poll token (broadcast): [seq lo]
+ * reply (chained)       : [addr << 2 | value >> 8][value lo][crc8]
+ * the crc8 (checksum_crc8) covers [seq lo][reply 0][reply 1], so a reply to
+ * an older token fails. a 1 or 3 byte frame is never rtu, so both protocols
+ * share the bus and modbus stays available for configuration.
+ * the token latches DI value into the history ring like a snapshot (seq
+ * rebuilt from its low byte) and the replies follow the same chain.
+ * a token is only taken 1..LG_MODBUS_FAST_SEQ_WINDOW steps after the last
+ * latch, so a noise byte rarely latches; the first token after an enable
+ * is taken whatever its seq (resync).
+ * only addresses up to FAST_ADDR_MAX answer.
+ */
+#define LG_MODBUS_FAST_BASE_ADDR 0x00B0
+
+#define LG_MODBUS_FAST_ENABLE_ADDR LG_MODBUS_FAST_BASE_ADDR
+
+#define LG_MODBUS_FAST_REGS 1
+
+#define LG_MODBUS_FAST_REQ_LEN 1
+
+#define LG_MODBUS_FAST_RSP_LEN 3
+
+#define LG_MODBUS_FAST_ADDR_MAX 63
+
+/* ============================================================================
+ * config commit block (FC03/FC06/FC16)
+ * ========================================================================= */
+/*
+ * configuration registers (offsets, address, fc, threshold, calibration,
+ * factory reset) take effect at once but are only staged in ram.
+ * CONF_COMMIT (W): 1 stores the staged configuration in flash now
+ * CONF_COMMIT (R): 1 while staged changes are not in flash yet
+ * staged changes are also stored after LG_CONF_COMMIT_IDLE_MS without
+ * configuration writes, so a bulk change or a live tuning costs one record.
+ *
+ * CONF_OVS_RATIO (R/W): adc hardware oversampling, 2^n conversions per
+ *                       result (0: off, 1-8), staged like the rest
+ * CONF_OVS_SHIFT (R/W): result right shift, 0-ratio; ratio - shift <= 4
+ * write both with one FC16 to change them together, a pair that does not
+ * fit the trigger period is refused with ILLEGAL_DATA_VALUE (at 1 kHz, 10
+ * channels fit up to ratio 5). with oversampling on the sensor filter is
+ * first order (fc unchanged). modelled, not measured (same isr model as
+ * ISR_LAST): the block isr drops to about 18.7k (-O0) / 8.0k (-Os) cycles,
+ * any ratio, and 2^4 brings the NOISE rms near that of a 16 conversion
+ * average; read ISR_LAST and NOISE on the sensor to confirm.
+ */
+#define LG_MODBUS_CONF_BASE_ADDR 0x00C0
+
+#define LG_MODBUS_CONF_COMMIT_ADDR LG_MODBUS_CONF_BASE_ADDR
+
+#define LG_MODBUS_CONF_OVS_RATIO_ADDR (LG_MODBUS_CONF_BASE_ADDR + 1)
+
+#define LG_MODBUS_CONF_OVS_SHIFT_ADDR (LG_MODBUS_CONF_BASE_ADDR + 2)
+
+#define LG_MODBUS_CONF_REGS 3
+
+/* ============================================================================
+ * diagnostics block (FC04 input registers / FC06)
+ * ========================================================================= */
+/*
+ * ISR_LAST/MIN/MAX: adc block isr cost, core cycles (CORE_MHZ per us),
+ *                   timed with systick. estimated, not measured: about
+ *                   30.8k (-O0) / 19.5k (-Os) with the biquad and the
+ *                   defaults (four 10 channel sequences per block, 1 kHz),
+ *                   from an instruction level model of the isr with the
+ *                   cortex-m0+ cycle counts at zero wait states; flash wait
+ *                   states add to it, these registers give the real cost
+ * BLOCKS          : adc blocks processed, wraps (a stalled adc stops it)
+ * FRAMES          : frames received (t3.5 ended), wraps
+ * CRC_ERRORS      : received frames with a bad crc, wraps
+ * REPLIES         : frames sent, wraps
+ * LATENCY/_MAX    : end of request to start of reply, us (last/worst); the
+ *                   request ends at the receiver timeout (t3.5 after its
+ *                   last byte). estimated, not measured: about 80-140 us
+ *                   for FC03 of 10 registers, 20-35 us for the prebuilt
+ *                   DI_VALUE reply (-Os to -O0), from an instruction level
+ *                   model of the rx timeout to first tx byte path at zero
+ *                   wait states with no other interrupt; an adc block isr
+ *                   in between adds its cost, these registers give the
+ *                   real value
+ * LINE_ERRORS     : parity/noise/framing/overrun errors, wraps; the frame
+ *                   is still received and its crc decides
+ * NOISE           : per channel [min][max][rms x16] of the decimated input
+ *                   minus the filter output, adc counts, min/max as int16
+ * DIAG_RESET (W, holding, usually broadcast): 1 restarts min/max values
+ */
+#define LG_MODBUS_DIAG_ISR_LAST_ADDR 0x0000
+
+#define LG_MODBUS_DIAG_ISR_MIN_ADDR 0x0001
+
+#define LG_MODBUS_DIAG_ISR_MAX_ADDR 0x0002
+
+#define LG_MODBUS_DIAG_CORE_MHZ_ADDR 0x0003
+
+#define LG_MODBUS_DIAG_BLOCKS_ADDR 0x0004
+
+#define LG_MODBUS_DIAG_FRAMES_ADDR 0x0005
+
+#define LG_MODBUS_DIAG_CRC_ERRORS_ADDR 0x0006
+
+#define LG_MODBUS_DIAG_REPLIES_ADDR 0x0007
+
+#define LG_MODBUS_DIAG_LATENCY_ADDR 0x0008
+
+#define LG_MODBUS_DIAG_LATENCY_MAX_ADDR 0x0009
+
+#define LG_MODBUS_DIAG_LINE_ERRORS_ADDR 0x000A
+
+#define LG_MODBUS_DIAG_NOISE_ADDR 0x0010
+
+#define LG_MODBUS_DIAG_NOISE_STRIDE 3
+
+#define LG_MODBUS_DIAG_REGS (LG_MODBUS_DIAG_NOISE_ADDR + LG_MODBUS_DIAG_NOISE_STRIDE * LG_ADC_SENAOR_MAX_SIZE)
+
+#define LG_MODBUS_DIAG_RESET_ADDR 0x00D0
+
+/* ============================================================================
+ * history block (FC03/FC16/FC23)
+ * ========================================================================= */
+/*
+ * HIST_SINCE (W): slices newer than this seq are returned
+ * HIST_HEAD  (R): newest seq in the ring
+ * HIST_COUNT (R): slices returned in this read
+ * HIST_DATA  (R): count x [seq][value][tick]
+ * one FC23 (write since, read block) fetches a whole burst.
+ */
+#define LG_MODBUS_HIST_BASE_ADDR 0x0100
+
+#define LG_MODBUS_HIST_SINCE_ADDR LG_MODBUS_HIST_BASE_ADDR
+
+#define LG_MODBUS_HIST_HEAD_ADDR LG_MODBUS_HIST_BASE_ADDR
+
+#define LG_MODBUS_HIST_COUNT_ADDR (LG_MODBUS_HIST_BASE_ADDR + 1)
+
+#define LG_MODBUS_HIST_DATA_ADDR (LG_MODBUS_HIST_BASE_ADDR + 2)
+
+#define LG_MODBUS_HIST_REGS_MAX (2 + 3 * LG_HISTORY_SIZE)
+
+/*one FC03/FC23 read returns at most 125 registers*/
+#if (LG_MODBUS_HIST_REGS_MAX > 125)
+#error "LG_HISTORY_SIZE exceeds one history read"
+#endif
+
+/* ============================================================================
+ * change log block (FC03/FC16/FC23)
+ * ========================================================================= */
+/*
+ * report by exception: the sensor logs [seq][value] only when DI value
+ * changes between two latches, so an idle or fully covered sensor has
+ * nothing to send.
+ * CHG_SINCE  (W): entries newer than this seq are returned
+ * CHG_HEAD   (R): newest seq covered by the reply, DI value is known up to here
+ * CHG_STATUS (R): count | CHG_LOST if entries after since were overwritten
+ *                 | CHG_MORE if entries after head are still pending
+ * CHG_VALUE  (R): DI value at since
+ * CHG_DATA   (R): count x [seq][value], value holds from seq on
+ * one FC23 (write since, read block) fetches the changes, the read quantity
+ * only needs to cover the changes expected (min one entry).
+ */
+#define LG_MODBUS_CHG_BASE_ADDR 0x0180
+
+#define LG_MODBUS_CHG_SINCE_ADDR LG_MODBUS_CHG_BASE_ADDR
+
+#define LG_MODBUS_CHG_HEAD_ADDR LG_MODBUS_CHG_BASE_ADDR
+
+#define LG_MODBUS_CHG_STATUS_ADDR (LG_MODBUS_CHG_BASE_ADDR + 1)
+
+#define LG_MODBUS_CHG_VALUE_ADDR (LG_MODBUS_CHG_BASE_ADDR + 2)
+
+#define LG_MODBUS_CHG_DATA_ADDR (LG_MODBUS_CHG_BASE_ADDR + 3)
+
+#define LG_MODBUS_CHG_REGS_MIN (3 + 2)
+
+#define LG_MODBUS_CHG_REGS_MAX (3 + 2 * LG_CHANGE_LOG_SIZE)
+
+#define LG_MODBUS_CHG_LOST 0x8000
+
+#define LG_MODBUS_CHG_MORE 0x4000
+
 /* ============================================================================
  * public function prototype
  * ========================================================================= */
@@ -86,6 +358,11 @@ uint8_t lg_module_modbus_init(uint8_t addr);
 
 uint8_t lg_module_modbus_set_addr(uint8_t addr);
 
+uint8_t lg_module_modbus_set_baud(uint8_t code);
+
 uint8_t lg_module_modbus_pool(void);
 
+/*1 if a frame or a snapshot reply is waiting for lg_module_modbus_pool*/
+uint8_t lg_module_modbus_pending(void);
+
 #endif /* LG_MODULE_MODBUS_H */
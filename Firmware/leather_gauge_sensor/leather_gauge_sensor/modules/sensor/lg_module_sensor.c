@@ -6,21 +6,101 @@
 #include "adc.h"
 #include "tim.h"
 #include "lg_module_modbus.h"
-#include "lg_module_eeprom.h"
 /* ============================================================================
  * global variables
  * ========================================================================= */
-#ifndef LG_ADC_FS
-#define LG_ADC_FS 100.0f
+/*conversions summed per filter sample (first order cic): the biquad and the
+detection run at the tim3 trigger rate / LG_SENSOR_DECIMATION. 1 keeps them
+on every conversion (1 kHz), larger values save isr time but add detection
+latency, which fast belts cannot afford*/
+#ifndef LG_SENSOR_DECIMATION
+#define LG_SENSOR_DECIMATION 1
 #endif
+
+/*sequences per dma half buffer, one interrupt per half; a multiple of the
+decimation, each half gives LG_SENSOR_BLOCK / LG_SENSOR_DECIMATION filter samples.
+every sample is still filtered and detected, but the value callback runs once
+per half: 4 reports a change up to 4 ms late at 1 kHz, far below the filter delay*/
+#ifndef LG_SENSOR_BLOCK
+#define LG_SENSOR_BLOCK 4
+#endif
+
+#if (LG_SENSOR_BLOCK % LG_SENSOR_DECIMATION) != 0
+#error "LG_SENSOR_BLOCK must be a multiple of LG_SENSOR_DECIMATION"
+#endif
+
+#define LG_SENSOR_BLOCK_OUT (LG_SENSOR_BLOCK / LG_SENSOR_DECIMATION)
+
+/*1: fixed point biquad (no fpu on the G030), 0: float biquad*/
+#ifndef LG_SENSOR_BIQUAD_Q
+#define LG_SENSOR_BIQUAD_Q 1
+#endif
+
+/*adc clock cycles per conversion: 39.5 sampling + 12.5 successive approximation*/
+#ifndef LG_SENSOR_CONV_CYCLES
+#define LG_SENSOR_CONV_CYCLES 52
+#endif
+
+/*hardware oversampling ratio code limit: 2^8 = 256 conversions per result*/
+#define LG_SENSOR_OVS_RATIO_MAX 8
+/*the adc data register is 16 bit: at most 4 bits above the 12 bit result*/
+#define LG_SENSOR_OVS_EXTRA_MAX 4
+
+/*noise residual clamp for the mean square: 12 bit full scale keeps the
+accumulator (e^2 << LG_SENSOR_NOISE_SHIFT) inside 32 bits*/
+#define LG_SENSOR_NOISE_E_MAX 4095
 /* ============================================================================
  * global variables
  * ========================================================================= */
 static LG_SENSOR_TypeDef_t sensor = {0};
+#if LG_SENSOR_BIQUAD_Q
+static BiquadQ_t filter[LG_ADC_SENAOR_MAX_SIZE] = {0};
+#else
 static Biquad_t filter[LG_ADC_SENAOR_MAX_SIZE] = {0};
+#endif
+/*filter sample rate, Hz*/
+static uint32_t filter_fs = 0;
+/*filter cut frequency, Hz*/
+static float filter_fc = 0;
+/*hardware oversampling: ratio code (0: off, n: 2^n conversions per result)
+and bits the result carries above 12 (ratio - shift), changed with the dma stopped*/
+static uint8_t ovs_ratio = 0;
+static uint8_t ovs_extra = 0;
+/*first order low pass used with oversampling: alpha and state, Q16*/
+static int32_t pole_alpha = 0;
+static int32_t pole_y[LG_ADC_SENAOR_MAX_SIZE] = {0};
+/*circular dma buffer: two halves of LG_SENSOR_BLOCK sequences*/
+static uint16_t adc_dma[2][LG_SENSOR_BLOCK][LG_ADC_SENAOR_MAX_SIZE];
+/*detection context: the isr uses *detect_active, a change fills the other one*/
+static LG_DETECT_TypeDef_t detect[2] = {0};
+static LG_DETECT_TypeDef_t *volatile detect_active = &detect[0];
+/*isr cost and noise, written by the adc isr only*/
+static LG_DIAG_TypeDef_t diag = {0};
+/*set by lg_module_sensor_diag_reset, the isr restarts the statistics*/
+static volatile uint8_t diag_reset = 1;
+/*slice history, one entry per sync*/
+static LG_SLICE_TypeDef_t history[LG_HISTORY_SIZE];
+static volatile uint16_t history_head = 0;
+static volatile uint16_t history_count = 0;
+/*change log, one entry per latch where the DI value changed*/
+static LG_CHANGE_TypeDef_t changes[LG_CHANGE_LOG_SIZE];
+static volatile uint16_t changes_head = 0;
+static volatile uint16_t changes_count = 0;
+/*newest latch: seq and DI value*/
+static uint16_t changes_seq = 0;
+static uint16_t changes_value = 0;
+/*newest entry overwritten by the ring*/
+static LG_CHANGE_TypeDef_t changes_dropped = {0};
+static uint8_t changes_overrun = 0;
+/*state latched by the last sync frame*/
+static LG_SYNC_TypeDef_t sync = {0};
 /* ============================================================================
  * private function prototype
  * ========================================================================= */
+static uint32_t lg_module_sensor_trigger_fs(void);
+static uint8_t lg_module_sensor_ovs_apply(uint8_t ratio, uint8_t shift);
+static uint8_t lg_module_sensor_start(void);
+static void lg_module_sensor_process(uint16_t (*block)[LG_ADC_SENAOR_MAX_SIZE]);
 
 /* ============================================================================
  * public function definition
@@ -28,39 +108,83 @@ static Biquad_t filter[LG_ADC_SENAOR_MAX_SIZE] = {0};
 uint8_t lg_module_sensor_init(float fc)
 {
     uint8_t ret = 0;
-    /*filte init*/
-    for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
-    {
-        Biquad_Init(&filter[i], BQ_LOWPASS, fc, LG_ADC_FS, 0.707f);
-    }
+    /*filte init, at the rate tim3 really triggers the adc*/
+    filter_fs = lg_module_sensor_trigger_fs() / LG_SENSOR_DECIMATION;
+    lg_module_sensor_filter_set(fc);
     /*adc init*/
     if (HAL_ADCEx_Calibration_Start(&hadc1) != HAL_OK)
     {
         return 1;
     }
 
-    if (HAL_ADC_Start_DMA(&hadc1, (uint32_t *)sensor.raw, LG_ADC_SENAOR_MAX_SIZE) != HAL_OK)
+    ret = lg_module_sensor_start();
+
+    return ret;
+}
+
+uint8_t lg_module_sensor_oversampling_set(uint8_t ratio, uint8_t shift)
+{
+    uint64_t cycles;
+    uint8_t old_ratio;
+    uint8_t old_shift;
+
+    if (ratio > LG_SENSOR_OVS_RATIO_MAX || shift > ratio || (ratio - shift) > LG_SENSOR_OVS_EXTRA_MAX)
+    {
+        return 1;
+    }
+    /*every trigger converts the whole oversampled sequence (adc clock = pclk / 2),
+    it has to end before the next one*/
+    cycles = (uint64_t)LG_ADC_SENAOR_MAX_SIZE * LG_SENSOR_CONV_CYCLES * (1UL << ratio) * lg_module_sensor_trigger_fs();
+    if (cycles >= HAL_RCC_GetPCLK1Freq() / 2)
     {
         return 1;
     }
 
-    /*start timer triger*/
-    if (HAL_TIM_Base_Start(&htim3) != HAL_OK)
+    old_ratio = ovs_ratio;
+    old_shift = ovs_ratio - ovs_extra;
+
+    /*oversampling is only written with the adc disabled*/
+    if (HAL_TIM_Base_Stop(&htim3) != HAL_OK || HAL_ADC_Stop_DMA(&hadc1) != HAL_OK)
     {
+        /*never leave the acquisition stopped*/
+        lg_module_sensor_start();
         return 1;
     }
 
-    return ret;
+    if (lg_module_sensor_ovs_apply(ratio, shift) == 0 && lg_module_sensor_start() == 0)
+    {
+        return 0;
+    }
+
+    /*refused by the hal: back to the previous mode, still sampling*/
+    HAL_TIM_Base_Stop(&htim3);
+    HAL_ADC_Stop_DMA(&hadc1);
+    lg_module_sensor_ovs_apply(old_ratio, old_shift);
+    lg_module_sensor_start();
+
+    return 1;
 }
 
 uint8_t lg_module_sensor_filter_set(float fc)
 {
+    /*first order: backward euler rc, alpha = w / (1 + w)*/
+    float w = 6.2831853f * fc / (float)filter_fs;
+
+    filter_fc = fc;
+    pole_alpha = (int32_t)(w / (1.0f + w) * 65536.0f + 0.5f);
+    memset(pole_y, 0, sizeof(pole_y));
+
     for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
     {
+#if LG_SENSOR_BIQUAD_Q
+        /*init, resets the filter too (fc in 0.1 Hz steps, as in the register)*/
+        BiquadQ_Init(&filter[i], BQ_LOWPASS, (uint32_t)(fc * 10.0f + 0.5f), filter_fs, 707);
+#else
         /*reset filter*/
         Biquad_Reset(&filter[i]);
         /*init*/
-        Biquad_Init(&filter[i], BQ_LOWPASS, fc, LG_ADC_FS, 0.707f);
+        Biquad_Init(&filter[i], BQ_LOWPASS, fc, (float)filter_fs, 0.707f);
+#endif
     }
     return 0;
 }
@@ -71,34 +195,354 @@ uint8_t lg_module_sensor_get(LG_SENSOR_TypeDef_t *out)
 
     return 0;
 }
+
+void lg_module_sensor_detect_set(const LG_CONF_TypeDef_t *conf)
+{
+    LG_DETECT_TypeDef_t *next = (detect_active == &detect[0]) ? &detect[1] : &detect[0];
+
+    /*called from the main loop only: the isr is never halfway through next*/
+    for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+    {
+        next->offset[i] = (int32_t)(conf->offset[i] + 0.5f);
+    }
+    next->on = conf->threshold;
+    next->off = (int32_t)conf->threshold + LB_THESHOLD_HYSTERESIS;
+
+    /*single word store, the isr takes the old or the new context whole*/
+    detect_active = next;
+}
+
+uint16_t lg_module_sensor_value_get(void)
+{
+    /*single halfword read, safe against the adc isr*/
+    return *(volatile uint16_t *)&sensor.value;
+}
+
+const volatile LG_SENSOR_TypeDef_t *lg_module_sensor_ref(void)
+{
+    return &sensor;
+}
+
+__weak void lg_module_sensor_value_callback(uint16_t value)
+{
+    (void)value;
+}
+
+void lg_module_sensor_latch(uint16_t seq)
+{
+    LG_SLICE_TypeDef_t *slice = &history[history_head];
+
+    /*called from the uart isr on every sync frame*/
+    slice->seq = seq;
+    slice->value = lg_module_sensor_value_get();
+    slice->tick = (uint16_t)HAL_GetTick();
+
+    history_head = (history_head + 1) % LG_HISTORY_SIZE;
+    if (history_count < LG_HISTORY_SIZE)
+    {
+        history_count++;
+    }
+
+    /*log only changes, the first latch always goes in as a reference*/
+    if (changes_count == 0 || slice->value != changes_value)
+    {
+        if (changes_count == LG_CHANGE_LOG_SIZE)
+        {
+            changes_dropped = changes[changes_head];
+            changes_overrun = 1;
+        }
+        changes[changes_head].seq = seq;
+        changes[changes_head].value = slice->value;
+        changes_head = (changes_head + 1) % LG_CHANGE_LOG_SIZE;
+        if (changes_count < LG_CHANGE_LOG_SIZE)
+        {
+            changes_count++;
+        }
+    }
+    changes_seq = seq;
+    changes_value = slice->value;
+}
+
+void lg_module_sensor_sync(uint16_t id)
+{
+    /*called from the uart isr, same instant on every sensor of the bus*/
+    sync.id = id;
+    sync.value = lg_module_sensor_value_get();
+    for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+    {
+        sync.D[i] = sensor.D[i];
+    }
+
+    lg_module_sensor_latch(id);
+}
+
+uint8_t lg_module_sensor_sync_get(LG_SYNC_TypeDef_t *out)
+{
+    __disable_irq();
+    memcpy(out, &sync, sizeof(LG_SYNC_TypeDef_t));
+    __enable_irq();
+
+    return 0;
+}
+
+uint8_t lg_module_sensor_diag_get(LG_DIAG_TypeDef_t *out)
+{
+    __disable_irq();
+    memcpy(out, &diag, sizeof(LG_DIAG_TypeDef_t));
+    __enable_irq();
+
+    return 0;
+}
+
+void lg_module_sensor_diag_reset(void)
+{
+    diag_reset = 1;
+}
+
+uint16_t lg_module_sensor_history_get(uint16_t since, LG_SLICE_TypeDef_t *out, uint16_t max, uint16_t *newest)
+{
+    uint16_t n = 0;
+    uint16_t first;
+    LG_SLICE_TypeDef_t *slice;
+
+    __disable_irq();
+    /*oldest entry first*/
+    first = (history_head + LG_HISTORY_SIZE - history_count) % LG_HISTORY_SIZE;
+    *newest = (history_count != 0) ? history[(history_head + LG_HISTORY_SIZE - 1) % LG_HISTORY_SIZE].seq : since;
+
+    for (uint16_t i = 0; i < history_count && n < max; i++)
+    {
+        slice = &history[(first + i) % LG_HISTORY_SIZE];
+        /*newer than since, with 16 bit wrap*/
+        if ((int16_t)(slice->seq - since) > 0)
+        {
+            out[n++] = *slice;
+        }
+    }
+    __enable_irq();
+
+    return n;
+}
+
+uint16_t lg_module_sensor_changes_get(uint16_t since, LG_CHANGE_TypeDef_t *out, uint16_t max, LG_CHANGES_TypeDef_t *info)
+{
+    uint16_t n = 0;
+    uint16_t first;
+    LG_CHANGE_TypeDef_t *entry;
+
+    __disable_irq();
+    /*oldest entry first*/
+    first = (changes_head + LG_CHANGE_LOG_SIZE - changes_count) % LG_CHANGE_LOG_SIZE;
+    info->head = (changes_count != 0) ? changes_seq : since;
+    /*the value at since is the last change up to since, maybe already dropped*/
+    info->base = changes_overrun ? changes_dropped.value : changes_value;
+    /*a change between since and the oldest entry is gone*/
+    info->lost = (changes_overrun && (int16_t)(changes_dropped.seq - since) > 0) ? 1 : 0;
+    info->more = 0;
+
+    for (uint16_t i = 0; i < changes_count; i++)
+    {
+        entry = &changes[(first + i) % LG_CHANGE_LOG_SIZE];
+        /*newer than since, with 16 bit wrap*/
+        if ((int16_t)(entry->seq - since) <= 0)
+        {
+            info->base = entry->value;
+            continue;
+        }
+        if (n == max)
+        {
+            /*truncated: the reply only covers up to the entry before this one*/
+            info->head = entry->seq - 1;
+            info->more = 1;
+            break;
+        }
+        out[n++] = *entry;
+    }
+    __enable_irq();
+
+    return n;
+}
 /* ============================================================================
  * private function definition
  * ========================================================================= */
+static uint32_t lg_module_sensor_trigger_fs(void)
+{
+    uint32_t clk = HAL_RCC_GetPCLK1Freq();
+
+    /*timer kernel clock is twice pclk when the apb is divided*/
+    if ((RCC->CFGR & RCC_CFGR_PPRE) != 0)
+    {
+        clk *= 2;
+    }
+
+    /*adc conversions per second, one per tim3 update*/
+    return clk / ((htim3.Instance->PSC + 1UL) * (htim3.Instance->ARR + 1UL));
+}
+
+/**
+ * @brief write the oversampling mode, adc and dma stopped
+ */
+static uint8_t lg_module_sensor_ovs_apply(uint8_t ratio, uint8_t shift)
+{
+    if (ratio == 0)
+    {
+        hadc1.Init.OversamplingMode = DISABLE;
+    }
+    else
+    {
+        hadc1.Init.OversamplingMode = ENABLE;
+        hadc1.Init.Oversampling.Ratio = (uint32_t)(ratio - 1) << ADC_CFGR2_OVSR_Pos;
+        hadc1.Init.Oversampling.RightBitShift = (uint32_t)shift << ADC_CFGR2_OVSS_Pos;
+        /*one trigger runs all the conversions of a result*/
+        hadc1.Init.Oversampling.TriggeredMode = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
+    }
+    if (HAL_ADC_Init(&hadc1) != HAL_OK)
+    {
+        return 1;
+    }
+
+    /*dma stopped: the isr does not run until the restart*/
+    ovs_ratio = ratio;
+    ovs_extra = ratio - shift;
+    /*the other filter takes over from a clean state*/
+    lg_module_sensor_filter_set(filter_fc);
+
+    return 0;
+}
+
+static uint8_t lg_module_sensor_start(void)
+{
+    /*circular: half and full transfer each hand over LG_SENSOR_BLOCK sequences*/
+    if (HAL_ADC_Start_DMA(&hadc1, (uint32_t *)adc_dma, 2 * LG_SENSOR_BLOCK * LG_ADC_SENAOR_MAX_SIZE) != HAL_OK)
+    {
+        return 1;
+    }
+
+    /*start timer triger*/
+    if (HAL_TIM_Base_Start(&htim3) != HAL_OK)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    /*first half is complete, the dma is filling the second one*/
+    lg_module_sensor_process(adc_dma[0]);
+}
 
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
 {
-    LG_CONF_TypeDef_t conf = {0};
-    /* Prevent unused argument(s) compilation warning */
-    lg_module_eeprom_conf_get(&conf);
-    /*filter data*/
+    lg_module_sensor_process(adc_dma[1]);
+}
+
+static void lg_module_sensor_process(uint16_t (*block)[LG_ADC_SENAOR_MAX_SIZE])
+{
+    /*read once: a configuration change swaps the whole context*/
+    const LG_DETECT_TypeDef_t *ctx = detect_active;
+    uint16_t value = sensor.value;
+    int32_t x[LG_SENSOR_BLOCK_OUT];
+    int32_t y[LG_SENSOR_BLOCK_OUT];
+    uint32_t sum;
+    int32_t s;
+    int32_t d;
+    int32_t e;
+    uint32_t e2;
+    LG_NOISE_TypeDef_t *noise;
+    uint32_t start = SysTick->VAL;
+    uint32_t end;
+    uint32_t cycles;
+
+    if (diag_reset)
+    {
+        diag_reset = 0;
+        diag.isr_min = UINT16_MAX;
+        diag.isr_max = 0;
+        for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
+        {
+            diag.noise[i].min = INT16_MAX;
+            diag.noise[i].max = INT16_MIN;
+        }
+    }
+    /*one channel at a time through the whole block*/
     for (uint8_t i = 0; i < LG_ADC_SENAOR_MAX_SIZE; i++)
     {
-        /*apply filter*/
-        sensor.S[i] = Biquad_Apply(&filter[i], sensor.raw[i]);
-        sensor.S[i] = (sensor.S[i] < 0) ? 0 : sensor.S[i];
-        /*apply offset*/
-        sensor.D[i] = sensor.S[i] - conf.offset[i];
-        sensor.D[i] = (sensor.D[i] < 0) ? 0 : sensor.D[i];
-        /*detect*/
-        if (sensor.D[i] <= conf.threshold)
+        /*decimation: average of LG_SENSOR_DECIMATION sequences, back to 12 bit adc counts*/
+        for (uint8_t k = 0; k < LG_SENSOR_BLOCK_OUT; k++)
+        {
+            sum = 0;
+            for (uint8_t j = 0; j < LG_SENSOR_DECIMATION; j++)
+            {
+                sum += block[k * LG_SENSOR_DECIMATION + j][i];
+            }
+            x[k] = (int32_t)(((sum >> ovs_extra) + LG_SENSOR_DECIMATION / 2) / LG_SENSOR_DECIMATION);
+        }
+        /*apply filter: the hardware already averaged, a first order is enough*/
+        if (ovs_ratio != 0)
+        {
+            for (uint8_t k = 0; k < LG_SENSOR_BLOCK_OUT; k++)
+            {
+                pole_y[i] += (int32_t)(((int64_t)((x[k] << 16) - pole_y[i]) * pole_alpha) >> 16);
+                y[k] = (pole_y[i] + 0x8000) >> 16;
+            }
+        }
+        else
         {
-            sensor.value |= 1 << (i); // set bit
+#if LG_SENSOR_BIQUAD_Q
+            BiquadQ_ApplyBlock(&filter[i], x, y, LG_SENSOR_BLOCK_OUT);
+#else
+            for (uint8_t k = 0; k < LG_SENSOR_BLOCK_OUT; k++)
+            {
+                y[k] = (int32_t)Biquad_Apply(&filter[i], (float)x[k]);
+            }
+#endif
         }
-        else if (sensor.D[i] >= (conf.threshold + LB_THESHOLD_HYSTERESIS))
+        noise = &diag.noise[i];
+        /*detect, sample by sample for the hysteresis*/
+        for (uint8_t k = 0; k < LG_SENSOR_BLOCK_OUT; k++)
         {
-            sensor.value &= ~(1 << i); // clear
+            /*noise: what the filter removed from this sample*/
+            e = x[k] - y[k];
+            e = (e > INT16_MAX) ? INT16_MAX : (e < INT16_MIN) ? INT16_MIN : e;
+            noise->min = (e < noise->min) ? (int16_t)e : noise->min;
+            noise->max = (e > noise->max) ? (int16_t)e : noise->max;
+            /*ema kept scaled by 2^LG_SENSOR_NOISE_SHIFT (no step below 1 count^2 is
+            lost), the decay is rounded so the reading is not biased up*/
+            e2 = (e > LG_SENSOR_NOISE_E_MAX || e < -LG_SENSOR_NOISE_E_MAX) ? (uint32_t)LG_SENSOR_NOISE_E_MAX * LG_SENSOR_NOISE_E_MAX
+                                                                           : (uint32_t)(e * e);
+            noise->ms_acc += e2 - ((noise->ms_acc + (1U << (LG_SENSOR_NOISE_SHIFT - 1))) >> LG_SENSOR_NOISE_SHIFT);
+
+            s = (y[k] < 0) ? 0 : y[k];
+            /*apply offset*/
+            d = s - ctx->offset[i];
+            d = (d < 0) ? 0 : d;
+            if (d <= ctx->on)
+            {
+                value |= 1 << (i); // set bit
+            }
+            else if (d >= ctx->off)
+            {
+                value &= ~(1 << i); // clear
+            }
         }
+        sensor.S[i] = (uint16_t)s;
+        sensor.D[i] = (uint16_t)d;
+        /*newest conversion for the raw registers*/
+        sensor.raw[i] = block[LG_SENSOR_BLOCK - 1][i] >> ovs_extra;
+    }
+    if (value != sensor.value)
+    {
+        sensor.value = value;
+        lg_module_sensor_value_callback(value);
     }
-    /*detect*/
+    /*systick counts down and wraps every millisecond*/
+    end = SysTick->VAL;
+    cycles = (start >= end) ? start - end : start + SysTick->LOAD + 1 - end;
+    diag.isr_last = (cycles > UINT16_MAX) ? UINT16_MAX : (uint16_t)cycles;
+    diag.isr_min = (diag.isr_last < diag.isr_min) ? diag.isr_last : diag.isr_min;
+    diag.isr_max = (diag.isr_last > diag.isr_max) ? diag.isr_last : diag.isr_max;
+    diag.blocks++;
     return;
 }
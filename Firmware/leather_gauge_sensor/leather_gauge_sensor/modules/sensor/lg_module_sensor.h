@@ -28,4 +28,40 @@ uint8_t lg_module_sensor_get(LG_SENSOR_TypeDef_t *out);
 
 uint8_t lg_module_sensor_filter_set(float fc);
 
+/*hardware oversampling: 2^ratio conversions per result (0: off), right shift 0..ratio,
+restarts the acquisition; 1: ratio/shift not valid or too slow for the trigger rate*/
+uint8_t lg_module_sensor_oversampling_set(uint8_t ratio, uint8_t shift);
+
+uint16_t lg_module_sensor_value_get(void);
+
+/*called from the adc isr when the DI value changes, weak default does nothing*/
+void lg_module_sensor_value_callback(uint16_t value);
+
+/*live state for single register reads, each halfword is read whole against the adc isr*/
+const volatile LG_SENSOR_TypeDef_t *lg_module_sensor_ref(void);
+
+/*rebuild the detection context from the configuration, swapped in one store*/
+void lg_module_sensor_detect_set(const LG_CONF_TypeDef_t *conf);
+
+/*copy the isr cost and noise statistics*/
+uint8_t lg_module_sensor_diag_get(LG_DIAG_TypeDef_t *out);
+
+/*restart min/max statistics, applied by the next adc block*/
+void lg_module_sensor_diag_reset(void);
+
+/*push the current DI value into the history ring, tagged with seq*/
+void lg_module_sensor_latch(uint16_t seq);
+
+/*latch the filtered state tagged with id (sync frame), also pushes a history slice*/
+void lg_module_sensor_sync(uint16_t id);
+
+/*copy the state latched by the last sync frame*/
+uint8_t lg_module_sensor_sync_get(LG_SYNC_TypeDef_t *out);
+
+/*copy up to max slices newer than since (oldest first), returns the count*/
+uint16_t lg_module_sensor_history_get(uint16_t since, LG_SLICE_TypeDef_t *out, uint16_t max, uint16_t *newest);
+
+/*copy up to max (>= 1) change log entries newer than since (oldest first), returns the count*/
+uint16_t lg_module_sensor_changes_get(uint16_t since, LG_CHANGE_TypeDef_t *out, uint16_t max, LG_CHANGES_TypeDef_t *info);
+
 #endif // LG_MODULE_SENSOR_H
@@ -29,6 +29,54 @@ typedef struct {
     float y1, y2; // y[n-1], y[n-2]
 } Biquad_t;
 
+/*
+ * Variante en punto fijo (BiquadQ) para núcleos sin FPU.
+ * Coeficientes en Q(BIQUAD_Q_COEF_FRAC), historia con BIQUAD_Q_OUT_FRAC bits
+ * fraccionarios, acumulador de BIQUAD_Q_ACC_BITS bits:
+ *  - 64: coeficientes Q30, muestras de hasta 14 bits, cualquier fc/fs.
+ *  - 32: coeficientes Q14, muestras de hasta 12 bits (ADC), solo multiplicaciones
+ *        de 32 bits; la precisión de los coeficientes exige fc/fs > ~0.02.
+ */
+#ifndef BIQUAD_Q_ACC_BITS
+#define BIQUAD_Q_ACC_BITS 64
+#endif
+
+#if (BIQUAD_Q_ACC_BITS == 64)
+typedef int64_t BiquadQAcc_t;
+#ifndef BIQUAD_Q_COEF_FRAC
+#define BIQUAD_Q_COEF_FRAC 30
+#endif
+#ifndef BIQUAD_Q_OUT_FRAC
+#define BIQUAD_Q_OUT_FRAC 16
+#endif
+#elif (BIQUAD_Q_ACC_BITS == 32)
+typedef int32_t BiquadQAcc_t;
+#ifndef BIQUAD_Q_COEF_FRAC
+#define BIQUAD_Q_COEF_FRAC 14
+#endif
+#ifndef BIQUAD_Q_OUT_FRAC
+#define BIQUAD_Q_OUT_FRAC 0
+#endif
+#else
+#error "BIQUAD_Q_ACC_BITS debe ser 32 o 64"
+#endif
+
+/* Límite de saturación de la salida (y de la historia), en Q(BIQUAD_Q_OUT_FRAC) */
+#ifndef BIQUAD_Q_STATE_MAX
+#define BIQUAD_Q_STATE_MAX ((int32_t)((1UL << (BIQUAD_Q_OUT_FRAC + 13)) - 1))
+#endif
+
+/* Estructura de coeficientes y estado en punto fijo */
+typedef struct {
+    // Coeficientes, Q(BIQUAD_Q_COEF_FRAC)
+    int32_t b0, b1, b2;
+    int32_t a1, a2;
+
+    // Historia, Q(BIQUAD_Q_OUT_FRAC)
+    int32_t x1, x2;
+    int32_t y1, y2;
+} BiquadQ_t;
+
 /**
  * @brief Inicializa y calcula los coeficientes del filtro.
  * @param f: Puntero a la estructura del filtro.
@@ -51,4 +99,54 @@ void Biquad_Reset(Biquad_t *f);
  */
 float Biquad_Apply(Biquad_t *f, float x);
 
+/**
+ * @brief Aplica el filtro a un bloque de muestras.
+ *
+ * Misma salida que n llamadas a Biquad_Apply, con la historia en registros
+ * durante todo el bloque. Admite x == y (en el mismo buffer).
+ *
+ * @param x: Muestras de entrada.
+ * @param y: Muestras filtradas.
+ * @param n: Número de muestras.
+ */
+void Biquad_ApplyBlock(Biquad_t *f, const float *x, float *y, uint32_t n);
+
+/**
+ * @brief Inicializa el filtro en punto fijo, sin sinf/cosf ni flotantes.
+ *
+ * Seno y coseno salen de una tabla de un cuarto de onda (Q30) con
+ * interpolación lineal; solo hay divisiones enteras aquí, nunca en Apply.
+ * Con fc >= fs/2 el filtro queda en paso directo.
+ *
+ * @param f: Puntero a la estructura del filtro.
+ * @param type: Tipo de filtro (BQ_LOWPASS, BQ_HIGHPASS, etc.)
+ * @param fc_x10: Frecuencia de corte en décimas de Hz.
+ * @param fs: Frecuencia de muestreo (Hz).
+ * @param q_x1000: Factor de calidad x1000 (707 para Butterworth).
+ */
+void BiquadQ_Init(BiquadQ_t *f, BiquadFilterType type, uint32_t fc_x10, uint32_t fs, uint32_t q_x1000);
+
+/**
+ * @brief Resetea la historia del filtro en punto fijo.
+ */
+void BiquadQ_Reset(BiquadQ_t *f);
+
+/**
+ * @brief Aplica el filtro en punto fijo a una nueva muestra.
+ * @param x: Muestra de entrada entera (cuentas de ADC).
+ * @return int32_t: Muestra filtrada y redondeada, saturada a BIQUAD_Q_STATE_MAX.
+ */
+int32_t BiquadQ_Apply(BiquadQ_t *f, int32_t x);
+
+/**
+ * @brief Aplica el filtro en punto fijo a un bloque de muestras.
+ *
+ * Misma salida que n llamadas a BiquadQ_Apply; admite x == y.
+ *
+ * @param x: Muestras de entrada enteras.
+ * @param y: Muestras filtradas, redondeadas y saturadas.
+ * @param n: Número de muestras.
+ */
+void BiquadQ_ApplyBlock(BiquadQ_t *f, const int32_t *x, int32_t *y, uint32_t n);
+
 #endif /* DSP_BIQUAD_H_ */
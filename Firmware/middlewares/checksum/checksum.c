@@ -0,0 +1,176 @@
+/*
+ * checksum.c
+ * Descripción: CRC por tabla (un byte por iteración, 256 entradas en flash).
+ */
+
+#include "checksum.h"
+
+/* CRC16/MODBUS, poly 0xA001 (0x8005 reflejado) */
+static const uint16_t crc16_table[256] = {
+    0x0000U, 0xC0C1U, 0xC181U, 0x0140U, 0xC301U, 0x03C0U, 0x0280U, 0xC241U,
+    0xC601U, 0x06C0U, 0x0780U, 0xC741U, 0x0500U, 0xC5C1U, 0xC481U, 0x0440U,
+    0xCC01U, 0x0CC0U, 0x0D80U, 0xCD41U, 0x0F00U, 0xCFC1U, 0xCE81U, 0x0E40U,
+    0x0A00U, 0xCAC1U, 0xCB81U, 0x0B40U, 0xC901U, 0x09C0U, 0x0880U, 0xC841U,
+    0xD801U, 0x18C0U, 0x1980U, 0xD941U, 0x1B00U, 0xDBC1U, 0xDA81U, 0x1A40U,
+    0x1E00U, 0xDEC1U, 0xDF81U, 0x1F40U, 0xDD01U, 0x1DC0U, 0x1C80U, 0xDC41U,
+    0x1400U, 0xD4C1U, 0xD581U, 0x1540U, 0xD701U, 0x17C0U, 0x1680U, 0xD641U,
+    0xD201U, 0x12C0U, 0x1380U, 0xD341U, 0x1100U, 0xD1C1U, 0xD081U, 0x1040U,
+    0xF001U, 0x30C0U, 0x3180U, 0xF141U, 0x3300U, 0xF3C1U, 0xF281U, 0x3240U,
+    0x3600U, 0xF6C1U, 0xF781U, 0x3740U, 0xF501U, 0x35C0U, 0x3480U, 0xF441U,
+    0x3C00U, 0xFCC1U, 0xFD81U, 0x3D40U, 0xFF01U, 0x3FC0U, 0x3E80U, 0xFE41U,
+    0xFA01U, 0x3AC0U, 0x3B80U, 0xFB41U, 0x3900U, 0xF9C1U, 0xF881U, 0x3840U,
+    0x2800U, 0xE8C1U, 0xE981U, 0x2940U, 0xEB01U, 0x2BC0U, 0x2A80U, 0xEA41U,
+    0xEE01U, 0x2EC0U, 0x2F80U, 0xEF41U, 0x2D00U, 0xEDC1U, 0xEC81U, 0x2C40U,
+    0xE401U, 0x24C0U, 0x2580U, 0xE541U, 0x2700U, 0xE7C1U, 0xE681U, 0x2640U,
+    0x2200U, 0xE2C1U, 0xE381U, 0x2340U, 0xE101U, 0x21C0U, 0x2080U, 0xE041U,
+    0xA001U, 0x60C0U, 0x6180U, 0xA141U, 0x6300U, 0xA3C1U, 0xA281U, 0x6240U,
+    0x6600U, 0xA6C1U, 0xA781U, 0x6740U, 0xA501U, 0x65C0U, 0x6480U, 0xA441U,
+    0x6C00U, 0xACC1U, 0xAD81U, 0x6D40U, 0xAF01U, 0x6FC0U, 0x6E80U, 0xAE41U,
+    0xAA01U, 0x6AC0U, 0x6B80U, 0xAB41U, 0x6900U, 0xA9C1U, 0xA881U, 0x6840U,
+    0x7800U, 0xB8C1U, 0xB981U, 0x7940U, 0xBB01U, 0x7BC0U, 0x7A80U, 0xBA41U,
+    0xBE01U, 0x7EC0U, 0x7F80U, 0xBF41U, 0x7D00U, 0xBDC1U, 0xBC81U, 0x7C40U,
+    0xB401U, 0x74C0U, 0x7580U, 0xB541U, 0x7700U, 0xB7C1U, 0xB681U, 0x7640U,
+    0x7200U, 0xB2C1U, 0xB381U, 0x7340U, 0xB101U, 0x71C0U, 0x7080U, 0xB041U,
+    0x5000U, 0x90C1U, 0x9181U, 0x5140U, 0x9301U, 0x53C0U, 0x5280U, 0x9241U,
+    0x9601U, 0x56C0U, 0x5780U, 0x9741U, 0x5500U, 0x95C1U, 0x9481U, 0x5440U,
+    0x9C01U, 0x5CC0U, 0x5D80U, 0x9D41U, 0x5F00U, 0x9FC1U, 0x9E81U, 0x5E40U,
+    0x5A00U, 0x9AC1U, 0x9B81U, 0x5B40U, 0x9901U, 0x59C0U, 0x5880U, 0x9841U,
+    0x8801U, 0x48C0U, 0x4980U, 0x8941U, 0x4B00U, 0x8BC1U, 0x8A81U, 0x4A40U,
+    0x4E00U, 0x8EC1U, 0x8F81U, 0x4F40U, 0x8D01U, 0x4DC0U, 0x4C80U, 0x8C41U,
+    0x4400U, 0x84C1U, 0x8581U, 0x4540U, 0x8701U, 0x47C0U, 0x4680U, 0x8641U,
+    0x8201U, 0x42C0U, 0x4380U, 0x8341U, 0x4100U, 0x81C1U, 0x8081U, 0x4040U,};
+
+/* CRC32 de configuración, poly 0x04C11DB7 desplazando a la derecha */
+static const uint32_t crc32_table[256] = {
+    0x00000000UL, 0x06233697UL, 0x05C45641UL, 0x03E760D6UL, 0x020A97EDUL, 0x0429A17AUL,
+    0x07CEC1ACUL, 0x01EDF73BUL, 0x04152FDAUL, 0x0236194DUL, 0x01D1799BUL, 0x07F24F0CUL,
+    0x061FB837UL, 0x003C8EA0UL, 0x03DBEE76UL, 0x05F8D8E1UL, 0x01A864DBUL, 0x078B524CUL,
+    0x046C329AUL, 0x024F040DUL, 0x03A2F336UL, 0x0581C5A1UL, 0x0666A577UL, 0x004593E0UL,
+    0x05BD4B01UL, 0x039E7D96UL, 0x00791D40UL, 0x065A2BD7UL, 0x07B7DCECUL, 0x0194EA7BUL,
+    0x02738AADUL, 0x0450BC3AUL, 0x0350C9B6UL, 0x0573FF21UL, 0x06949FF7UL, 0x00B7A960UL,
+    0x015A5E5BUL, 0x077968CCUL, 0x049E081AUL, 0x02BD3E8DUL, 0x0745E66CUL, 0x0166D0FBUL,
+    0x0281B02DUL, 0x04A286BAUL, 0x054F7181UL, 0x036C4716UL, 0x008B27C0UL, 0x06A81157UL,
+    0x02F8AD6DUL, 0x04DB9BFAUL, 0x073CFB2CUL, 0x011FCDBBUL, 0x00F23A80UL, 0x06D10C17UL,
+    0x05366CC1UL, 0x03155A56UL, 0x06ED82B7UL, 0x00CEB420UL, 0x0329D4F6UL, 0x050AE261UL,
+    0x04E7155AUL, 0x02C423CDUL, 0x0123431BUL, 0x0700758CUL, 0x06A1936CUL, 0x0082A5FBUL,
+    0x0365C52DUL, 0x0546F3BAUL, 0x04AB0481UL, 0x02883216UL, 0x016F52C0UL, 0x074C6457UL,
+    0x02B4BCB6UL, 0x04978A21UL, 0x0770EAF7UL, 0x0153DC60UL, 0x00BE2B5BUL, 0x069D1DCCUL,
+    0x057A7D1AUL, 0x03594B8DUL, 0x0709F7B7UL, 0x012AC120UL, 0x02CDA1F6UL, 0x04EE9761UL,
+    0x0503605AUL, 0x032056CDUL, 0x00C7361BUL, 0x06E4008CUL, 0x031CD86DUL, 0x053FEEFAUL,
+    0x06D88E2CUL, 0x00FBB8BBUL, 0x01164F80UL, 0x07357917UL, 0x04D219C1UL, 0x02F12F56UL,
+    0x05F15ADAUL, 0x03D26C4DUL, 0x00350C9BUL, 0x06163A0CUL, 0x07FBCD37UL, 0x01D8FBA0UL,
+    0x023F9B76UL, 0x041CADE1UL, 0x01E47500UL, 0x07C74397UL, 0x04202341UL, 0x020315D6UL,
+    0x03EEE2EDUL, 0x05CDD47AUL, 0x062AB4ACUL, 0x0009823BUL, 0x04593E01UL, 0x027A0896UL,
+    0x019D6840UL, 0x07BE5ED7UL, 0x0653A9ECUL, 0x00709F7BUL, 0x0397FFADUL, 0x05B4C93AUL,
+    0x004C11DBUL, 0x066F274CUL, 0x0588479AUL, 0x03AB710DUL, 0x02468636UL, 0x0465B0A1UL,
+    0x0782D077UL, 0x01A1E6E0UL, 0x04C11DB7UL, 0x02E22B20UL, 0x01054BF6UL, 0x07267D61UL,
+    0x06CB8A5AUL, 0x00E8BCCDUL, 0x030FDC1BUL, 0x052CEA8CUL, 0x00D4326DUL, 0x06F704FAUL,
+    0x0510642CUL, 0x033352BBUL, 0x02DEA580UL, 0x04FD9317UL, 0x071AF3C1UL, 0x0139C556UL,
+    0x0569796CUL, 0x034A4FFBUL, 0x00AD2F2DUL, 0x068E19BAUL, 0x0763EE81UL, 0x0140D816UL,
+    0x02A7B8C0UL, 0x04848E57UL, 0x017C56B6UL, 0x075F6021UL, 0x04B800F7UL, 0x029B3660UL,
+    0x0376C15BUL, 0x0555F7CCUL, 0x06B2971AUL, 0x0091A18DUL, 0x0791D401UL, 0x01B2E296UL,
+    0x02558240UL, 0x0476B4D7UL, 0x059B43ECUL, 0x03B8757BUL, 0x005F15ADUL, 0x067C233AUL,
+    0x0384FBDBUL, 0x05A7CD4CUL, 0x0640AD9AUL, 0x00639B0DUL, 0x018E6C36UL, 0x07AD5AA1UL,
+    0x044A3A77UL, 0x02690CE0UL, 0x0639B0DAUL, 0x001A864DUL, 0x03FDE69BUL, 0x05DED00CUL,
+    0x04332737UL, 0x021011A0UL, 0x01F77176UL, 0x07D447E1UL, 0x022C9F00UL, 0x040FA997UL,
+    0x07E8C941UL, 0x01CBFFD6UL, 0x002608EDUL, 0x06053E7AUL, 0x05E25EACUL, 0x03C1683BUL,
+    0x02608EDBUL, 0x0443B84CUL, 0x07A4D89AUL, 0x0187EE0DUL, 0x006A1936UL, 0x06492FA1UL,
+    0x05AE4F77UL, 0x038D79E0UL, 0x0675A101UL, 0x00569796UL, 0x03B1F740UL, 0x0592C1D7UL,
+    0x047F36ECUL, 0x025C007BUL, 0x01BB60ADUL, 0x0798563AUL, 0x03C8EA00UL, 0x05EBDC97UL,
+    0x060CBC41UL, 0x002F8AD6UL, 0x01C27DEDUL, 0x07E14B7AUL, 0x04062BACUL, 0x02251D3BUL,
+    0x07DDC5DAUL, 0x01FEF34DUL, 0x0219939BUL, 0x043AA50CUL, 0x05D75237UL, 0x03F464A0UL,
+    0x00130476UL, 0x063032E1UL, 0x0130476DUL, 0x071371FAUL, 0x04F4112CUL, 0x02D727BBUL,
+    0x033AD080UL, 0x0519E617UL, 0x06FE86C1UL, 0x00DDB056UL, 0x052568B7UL, 0x03065E20UL,
+    0x00E13EF6UL, 0x06C20861UL, 0x072FFF5AUL, 0x010CC9CDUL, 0x02EBA91BUL, 0x04C89F8CUL,
+    0x009823B6UL, 0x06BB1521UL, 0x055C75F7UL, 0x037F4360UL, 0x0292B45BUL, 0x04B182CCUL,
+    0x0756E21AUL, 0x0175D48DUL, 0x048D0C6CUL, 0x02AE3AFBUL, 0x01495A2DUL, 0x076A6CBAUL,
+    0x06879B81UL, 0x00A4AD16UL, 0x0343CDC0UL, 0x0560FB57UL,};
+
+/* CRC8 de las tramas cortas (fast scan), poly 0x07 */
+static const uint8_t crc8_table[256] = {
+    0x00U, 0x07U, 0x0EU, 0x09U, 0x1CU, 0x1BU, 0x12U, 0x15U, 0x38U, 0x3FU, 0x36U, 0x31U,
+    0x24U, 0x23U, 0x2AU, 0x2DU, 0x70U, 0x77U, 0x7EU, 0x79U, 0x6CU, 0x6BU, 0x62U, 0x65U,
+    0x48U, 0x4FU, 0x46U, 0x41U, 0x54U, 0x53U, 0x5AU, 0x5DU, 0xE0U, 0xE7U, 0xEEU, 0xE9U,
+    0xFCU, 0xFBU, 0xF2U, 0xF5U, 0xD8U, 0xDFU, 0xD6U, 0xD1U, 0xC4U, 0xC3U, 0xCAU, 0xCDU,
+    0x90U, 0x97U, 0x9EU, 0x99U, 0x8CU, 0x8BU, 0x82U, 0x85U, 0xA8U, 0xAFU, 0xA6U, 0xA1U,
+    0xB4U, 0xB3U, 0xBAU, 0xBDU, 0xC7U, 0xC0U, 0xC9U, 0xCEU, 0xDBU, 0xDCU, 0xD5U, 0xD2U,
+    0xFFU, 0xF8U, 0xF1U, 0xF6U, 0xE3U, 0xE4U, 0xEDU, 0xEAU, 0xB7U, 0xB0U, 0xB9U, 0xBEU,
+    0xABU, 0xACU, 0xA5U, 0xA2U, 0x8FU, 0x88U, 0x81U, 0x86U, 0x93U, 0x94U, 0x9DU, 0x9AU,
+    0x27U, 0x20U, 0x29U, 0x2EU, 0x3BU, 0x3CU, 0x35U, 0x32U, 0x1FU, 0x18U, 0x11U, 0x16U,
+    0x03U, 0x04U, 0x0DU, 0x0AU, 0x57U, 0x50U, 0x59U, 0x5EU, 0x4BU, 0x4CU, 0x45U, 0x42U,
+    0x6FU, 0x68U, 0x61U, 0x66U, 0x73U, 0x74U, 0x7DU, 0x7AU, 0x89U, 0x8EU, 0x87U, 0x80U,
+    0x95U, 0x92U, 0x9BU, 0x9CU, 0xB1U, 0xB6U, 0xBFU, 0xB8U, 0xADU, 0xAAU, 0xA3U, 0xA4U,
+    0xF9U, 0xFEU, 0xF7U, 0xF0U, 0xE5U, 0xE2U, 0xEBU, 0xECU, 0xC1U, 0xC6U, 0xCFU, 0xC8U,
+    0xDDU, 0xDAU, 0xD3U, 0xD4U, 0x69U, 0x6EU, 0x67U, 0x60U, 0x75U, 0x72U, 0x7BU, 0x7CU,
+    0x51U, 0x56U, 0x5FU, 0x58U, 0x4DU, 0x4AU, 0x43U, 0x44U, 0x19U, 0x1EU, 0x17U, 0x10U,
+    0x05U, 0x02U, 0x0BU, 0x0CU, 0x21U, 0x26U, 0x2FU, 0x28U, 0x3DU, 0x3AU, 0x33U, 0x34U,
+    0x4EU, 0x49U, 0x40U, 0x47U, 0x52U, 0x55U, 0x5CU, 0x5BU, 0x76U, 0x71U, 0x78U, 0x7FU,
+    0x6AU, 0x6DU, 0x64U, 0x63U, 0x3EU, 0x39U, 0x30U, 0x37U, 0x22U, 0x25U, 0x2CU, 0x2BU,
+    0x06U, 0x01U, 0x08U, 0x0FU, 0x1AU, 0x1DU, 0x14U, 0x13U, 0xAEU, 0xA9U, 0xA0U, 0xA7U,
+    0xB2U, 0xB5U, 0xBCU, 0xBBU, 0x96U, 0x91U, 0x98U, 0x9FU, 0x8AU, 0x8DU, 0x84U, 0x83U,
+    0xDEU, 0xD9U, 0xD0U, 0xD7U, 0xC2U, 0xC5U, 0xCCU, 0xCBU, 0xE6U, 0xE1U, 0xE8U, 0xEFU,
+    0xFAU, 0xFDU, 0xF4U, 0xF3U,};
+
+uint16_t checksum_crc16_update(uint16_t crc, const uint8_t *data, size_t length)
+{
+    while (length--)
+    {
+        crc = (uint16_t)(crc >> 8) ^ crc16_table[(uint8_t)(crc ^ *data++)];
+    }
+
+    return crc;
+}
+
+uint16_t checksum_crc16(const uint8_t *data, size_t length)
+{
+    return checksum_crc16_update(CHECKSUM_CRC16_INIT, data, length);
+}
+
+uint16_t checksum_nmbs_crc16(const uint8_t *data, uint32_t length, void *arg)
+{
+    uint16_t crc = checksum_crc16_update(CHECKSUM_CRC16_INIT, data, length);
+
+    (void)arg;
+
+    return (uint16_t)(crc << 8) | (uint16_t)(crc >> 8);
+}
+
+uint32_t checksum_crc32_update(uint32_t crc, const uint8_t *data, size_t length)
+{
+    while (length--)
+    {
+        crc = (crc >> 8) ^ crc32_table[(uint8_t)(crc ^ *data++)];
+    }
+
+    return crc;
+}
+
+uint32_t checksum_crc32_final(uint32_t crc)
+{
+    return crc ^ 0xFFFFFFFFUL;
+}
+
+uint32_t checksum_crc32(const uint8_t *data, size_t length)
+{
+    if (data == NULL || length == 0)
+    {
+        return 0;
+    }
+
+    return checksum_crc32_final(checksum_crc32_update(CHECKSUM_CRC32_INIT, data, length));
+}
+
+uint8_t checksum_crc8_update(uint8_t crc, const uint8_t *data, size_t length)
+{
+    while (length--)
+    {
+        crc = crc8_table[(uint8_t)(crc ^ *data++)];
+    }
+
+    return crc;
+}
+
+uint8_t checksum_crc8(const uint8_t *data, size_t length)
+{
+    return checksum_crc8_update(CHECKSUM_CRC8_INIT, data, length);
+}
@@ -0,0 +1,89 @@
+/*
+ * checksum.h
+ * Descripción: CRC por tabla para Modbus RTU y bloques de configuración.
+ * Soporta: CRC16/MODBUS, el CRC32 de la configuración (EEPROM/flash) y un
+ * CRC8 para tramas cortas, en una sola llamada o de forma incremental.
+ */
+
+#ifndef CHECKSUM_H_
+#define CHECKSUM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Valores iniciales para el cálculo incremental */
+#define CHECKSUM_CRC16_INIT 0xFFFFU
+#define CHECKSUM_CRC32_INIT 0xFFFFFFFFUL
+#define CHECKSUM_CRC8_INIT 0x00U
+
+/**
+ * @brief Acumula datos en un CRC16/MODBUS (poly 0xA001 reflejado).
+ * @param crc: Valor parcial (CHECKSUM_CRC16_INIT al comenzar).
+ * @param data: Datos a acumular.
+ * @param length: Número de bytes.
+ * @return uint16_t: CRC parcial; byte bajo primero en la trama.
+ */
+uint16_t checksum_crc16_update(uint16_t crc, const uint8_t *data, size_t length);
+
+/**
+ * @brief CRC16/MODBUS de un bloque completo.
+ */
+uint16_t checksum_crc16(const uint8_t *data, size_t length);
+
+/**
+ * @brief Adaptador para nmbs_platform_conf.crc_calc.
+ * @return uint16_t: CRC16 con los bytes intercambiados, igual que nmbs_crc_calc().
+ */
+uint16_t checksum_nmbs_crc16(const uint8_t *data, uint32_t length, void *arg);
+
+/**
+ * @brief Acumula datos en el CRC32 de configuración.
+ *
+ * Mismo resultado que el bucle bit a bit usado hasta ahora (desplazamiento a
+ * la derecha con el polinomio 0x04C11DB7 sin reflejar), para que las
+ * configuraciones ya grabadas sigan siendo válidas.
+ *
+ * @param crc: Valor parcial (CHECKSUM_CRC32_INIT al comenzar).
+ * @param data: Datos a acumular.
+ * @param length: Número de bytes.
+ * @return uint32_t: CRC parcial, sin la inversión final.
+ */
+uint32_t checksum_crc32_update(uint32_t crc, const uint8_t *data, size_t length);
+
+/**
+ * @brief Cierra un CRC32 incremental (inversión final).
+ */
+uint32_t checksum_crc32_final(uint32_t crc);
+
+/**
+ * @brief CRC32 de configuración de un bloque completo.
+ * @return uint32_t: CRC, o 0 si data es NULL o length es 0 (como antes).
+ */
+uint32_t checksum_crc32(const uint8_t *data, size_t length);
+
+/**
+ * @brief Acumula datos en un CRC8 (poly 0x07, sin reflejar).
+ *
+ * Para tramas de pocos bytes donde el CRC16 duplicaría la longitud.
+ *
+ * @param crc: Valor parcial (CHECKSUM_CRC8_INIT al comenzar).
+ * @param data: Datos a acumular.
+ * @param length: Número de bytes.
+ * @return uint8_t: CRC parcial.
+ */
+uint8_t checksum_crc8_update(uint8_t crc, const uint8_t *data, size_t length);
+
+/**
+ * @brief CRC8 de un bloque completo.
+ */
+uint8_t checksum_crc8(const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHECKSUM_H_ */
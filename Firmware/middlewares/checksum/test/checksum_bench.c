@@ -0,0 +1,180 @@
+/*
+ * checksum_bench.c
+ * Descripción: prueba y benchmark en el host de los CRC por tabla contra los
+ * bucles bit a bit que reemplazan (nmbs_crc_calc, lgc_crc32_compute/
+ * BSP_CRC32_Calculate y el CRC8 de referencia).
+ *
+ * Compilar y ejecutar desde Firmware/middlewares/checksum:
+ *   gcc -O2 -I. test/checksum_bench.c checksum.c -o checksum_bench
+ *   ./checksum_bench [MHz]
+ *
+ * Con la frecuencia de la CPU en MHz también imprime ciclos por byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "checksum.h"
+
+#define BENCH_CHECK_LEN_MAX 300
+#define BENCH_BUFFER_LEN 4096
+#define BENCH_ROUNDS 4000
+
+/* Copia de nmbs_crc_calc() (nanoMODBUS) */
+static uint16_t ref_nmbs_crc16(const uint8_t *data, uint32_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)data[i];
+        for (int j = 8; j != 0; j--)
+        {
+            if ((crc & 0x0001) != 0)
+            {
+                crc >>= 1;
+                crc ^= 0xA001;
+            }
+            else
+                crc >>= 1;
+        }
+    }
+
+    return (uint16_t)(crc << 8) | (uint16_t)(crc >> 8);
+}
+
+/* Copia del CRC32 de configuración anterior (lgc_crc32_compute) */
+static uint32_t ref_crc32(const uint8_t *data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+
+    if (data == NULL || length == 0)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= data[i];
+        for (size_t j = 0; j < 8; ++j)
+        {
+            if (crc & 1)
+            {
+                crc = (crc >> 1) ^ 0x04C11DB7UL;
+            }
+            else
+            {
+                crc >>= 1;
+            }
+        }
+    }
+
+    return crc ^ 0xFFFFFFFFUL;
+}
+
+/* CRC8 poly 0x07 sin reflejar, bit a bit */
+static uint8_t ref_crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = CHECKSUM_CRC8_INIT;
+
+    while (length--)
+    {
+        crc ^= *data++;
+        for (int j = 0; j < 8; j++)
+        {
+            crc = (crc & 0x80U) ? (uint8_t)((crc << 1) ^ 0x07U) : (uint8_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+static double bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Resultado acumulado para que el compilador no descarte los bucles */
+static volatile uint32_t bench_sink;
+
+#define BENCH_RUN(name, expr)                                              \
+    do                                                                     \
+    {                                                                      \
+        double t0 = bench_now_ns();                                        \
+        uint32_t acc = 0;                                                  \
+        for (int r = 0; r < BENCH_ROUNDS; r++)                             \
+        {                                                                  \
+            buf[0] = (uint8_t)r;                                           \
+            acc += (uint32_t)(expr);                                       \
+        }                                                                  \
+        double ns = (bench_now_ns() - t0) / ((double)BENCH_ROUNDS * BENCH_BUFFER_LEN); \
+        bench_sink += acc;                                                 \
+        if (mhz > 0.0)                                                     \
+            printf("  %-14s %6.2f ns/B  %6.1f cycles/B\n", name, ns, ns * mhz / 1000.0); \
+        else                                                               \
+            printf("  %-14s %6.2f ns/B\n", name, ns);                      \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    static uint8_t buf[BENCH_BUFFER_LEN];
+    double mhz = (argc > 1) ? atof(argv[1]) : 0.0;
+    unsigned errors = 0;
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(buf); i++)
+    {
+        buf[i] = (uint8_t)rand();
+    }
+
+    /* Mismo valor en una llamada y partido en dos actualizaciones */
+    for (size_t len = 1; len < BENCH_CHECK_LEN_MAX; len++)
+    {
+        size_t half = len / 2;
+        uint16_t c16 = checksum_crc16_update(CHECKSUM_CRC16_INIT, buf, half);
+        uint32_t c32 = checksum_crc32_update(CHECKSUM_CRC32_INIT, buf, half);
+        uint8_t c8 = checksum_crc8_update(CHECKSUM_CRC8_INIT, buf, half);
+
+        c16 = checksum_crc16_update(c16, buf + half, len - half);
+        c32 = checksum_crc32_final(checksum_crc32_update(c32, buf + half, len - half));
+        c8 = checksum_crc8_update(c8, buf + half, len - half);
+
+        if (checksum_nmbs_crc16(buf, (uint32_t)len, NULL) != ref_nmbs_crc16(buf, (uint32_t)len) ||
+            (uint16_t)(c16 << 8 | c16 >> 8) != ref_nmbs_crc16(buf, (uint32_t)len))
+        {
+            printf("crc16 mismatch, length %zu\n", len);
+            errors++;
+        }
+        if (checksum_crc32(buf, len) != ref_crc32(buf, len) || c32 != ref_crc32(buf, len))
+        {
+            printf("crc32 mismatch, length %zu\n", len);
+            errors++;
+        }
+        if (checksum_crc8(buf, len) != ref_crc8(buf, len) || c8 != ref_crc8(buf, len))
+        {
+            printf("crc8 mismatch, length %zu\n", len);
+            errors++;
+        }
+    }
+    if (checksum_crc32(buf, 0) != 0 || checksum_crc32(NULL, 4) != 0)
+    {
+        printf("crc32 empty input is not 0\n");
+        errors++;
+    }
+    printf("check, lengths 1-%d: %s\n", BENCH_CHECK_LEN_MAX - 1, errors ? "FAIL" : "ok");
+
+    printf("%d B buffer, %d rounds:\n", BENCH_BUFFER_LEN, BENCH_ROUNDS);
+    BENCH_RUN("crc16 bitwise", ref_nmbs_crc16(buf, BENCH_BUFFER_LEN));
+    BENCH_RUN("crc16 table", checksum_nmbs_crc16(buf, BENCH_BUFFER_LEN, NULL));
+    BENCH_RUN("crc32 bitwise", ref_crc32(buf, BENCH_BUFFER_LEN));
+    BENCH_RUN("crc32 table", checksum_crc32(buf, BENCH_BUFFER_LEN));
+    BENCH_RUN("crc8 bitwise", ref_crc8(buf, BENCH_BUFFER_LEN));
+    BENCH_RUN("crc8 table", checksum_crc8(buf, BENCH_BUFFER_LEN));
+
+    return errors ? 1 : 0;
+}